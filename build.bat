@@ -1,3 +1,5 @@
 
 CL /EHsc /Zi main.cpp /WL /link SDL2.lib SDL2_image.lib SDL2_mixer.lib >errors.err
 move /Y main.exe saber.exe
+saber.exe --compile-rooms >>errors.err
+saber.exe --pack-assets >>errors.err
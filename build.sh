@@ -1,3 +1,5 @@
 
 echo "=====jam game=====" > errors.err
 clang main.cpp -g -lm -lSDL2 -lSDL2_mixer -lSDL2_image -o jamgame 2>>errors.err
+./jamgame --compile-rooms >>errors.err
+./jamgame --pack-assets >>errors.err
@@ -10,6 +10,7 @@
 #include <cfloat>
 #include <cstring>
 #include <ctime>
+#include <sys/stat.h>
 #include "SDL/SDL.h"
 #include "SDL/SDL_mixer.h"
 #include "SDL/SDL_image.h"
@@ -21,13 +22,34 @@
 #include <float.h>
 #include <string.h>
 #include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_mixer.h>
 #include <SDL2/SDL_image.h>
 #endif
 
+#include "pool.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define WALL_LANES 8
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define WALL_LANES 4
+#endif
+
 // NOTE(afox): what the hell man
 #define PHYS_EPSILON sqrt(FLT_EPSILON) * 100
+// the same tolerance in 16.16, for the fixed point physics path
+#define PHYS_EPSILON_FX 2263
+
+// build with -DFIXED_PHYSICS to do getMotionWalled()'s sweep in 16.16 fixed
+// point. everything around it stays float, so it rounds differently from
+// the float build rather than more repeatably
 
 SDL_Window *win;
 SDL_Renderer *ren;
@@ -42,27 +64,14 @@ enum songstates {
 };
 int songstate;
 int running = 1;
-int frame;
-void loadLevel(const char * fname, int connection);
-
-#define maxof(lcs) lcs##_max
-#define countof(lcs) lcs##_count
-#define dataof(lcs) lcs##s
-
-#define tc_create(type, lcs, max) \
-   const int maxof(lcs) = max; \
-   type dataof(lcs)[max];\
-   int countof(lcs) = 0;
-
-#define tc_empty(lcs) (countof(lcs) == 0)
-#define tc_full(lcs) (countof(lcs) == maxof(lcs))
-#define tc_new(lcs) ((!tc_full(lcs))?(dataof(lcs)+(countof(lcs)++)):0)
-#define tc_inarray(lcs, ind) ((ind) >= 0 && (ind) < countof(lcs))
-#define tc_at(lcs, ind) (dataof(lcs) + (ind))
-#define tc_at_safe(lcs, ind) ((tc_inarray(lcs, ind))?tc_at(lcs, ind):0)
-#define tc_at_wrap(lcs, ind) (tc_at(lcs, (ind)%countof(lcs)))
-#define tc_back(lcs) (tc_at(lcs, (countof(lcs) - 1)))
-#define tc_erase(lcs, ind) {if (tc_inarray(lcs, ind)) { *tc_at(lcs, ind) = *tc_back(lcs); countof(lcs)--;}}
+// no window, renderer or audio: textures and sounds stay null
+int headless;
+// print how long each stage of simulate() took on the way out
+int task_times;
+// and how close to its deadlines each frame went out
+int pacer_stats;
+struct world;
+void loadLevel(world *wd, const char * fname, int connection);
 
 #define field_w 320
 #define field_h 240
@@ -83,14 +92,20 @@ int max(int a, int b)
 }
 #endif
 
+// one of the game's pictures, somewhere in the sprite atlas
+struct atlasimage {
+   SDL_Texture *tex;
+   SDL_Rect rect;
+};
+
 struct {
-   SDL_Texture *saber;
-   SDL_Texture *robots;
-   SDL_Texture *wall;
-   SDL_Texture *stone;
-   SDL_Texture *effect;
-   SDL_Texture *mirv;
-   SDL_Texture *ladder;
+   atlasimage saber;
+   atlasimage robots;
+   atlasimage wall;
+   atlasimage stone;
+   atlasimage effect;
+   atlasimage mirv;
+   atlasimage ladder;
 } tex;
 
 struct {
@@ -112,6 +127,9 @@ struct {
 
 void play(Mix_Chunk *ch)
 {
+   if (headless) {
+      return;
+   }
    Mix_PlayChannel(-1, ch, 0);
 }
 
@@ -120,15 +138,531 @@ struct {
    Mix_Music *level_theme;
 } music;
 
-SDL_Texture* loadTexture(const char* file)
+// every file the game loads at start besides the rooms, as tables so
+// --pack-assets packs exactly what gets loaded
+struct {
+   const char *file;
+   Mix_Chunk **chunk;
+} sound_files[] = {
+   {"sound/hit.wav", &sound.hit},
+   {"sound/mirv_engine.wav", &sound.mirv_engine},
+   {"sound/mirv_hit.wav", &sound.mirv_hit},
+   {"sound/mirv_die.wav", &sound.mirv_die},
+   {"sound/mirv_shotgun.wav", &sound.mirv_shotgun},
+   {"sound/reflect.wav", &sound.reflect},
+   {"sound/rock_break.wav", &sound.rock_break},
+   {"sound/saber_die.wav", &sound.saber_die},
+   {"sound/saber_hit.wav", &sound.saber_hit},
+   {"sound/saber_jump.wav", &sound.saber_jump},
+   {"sound/saber_shoot.wav", &sound.saber_shoot},
+   {"sound/saber_heal.wav", &sound.saber_heal},
+   {"sound/spider_hit.wav", &sound.spider_hit},
+   {"sound/spider_shoot.wav", &sound.spider_shoot},
+};
+
+struct {
+   const char *file;
+   Mix_Music **music;
+} music_files[] = {
+   {"sound/mirv_theme_scott.wav", &music.mirv_theme},
+   {"sound/saber_level_theme.wav", &music.level_theme},
+};
+
+struct {
+   const char *file;
+   atlasimage *image;
+} atlas_files[] = {
+   {"saber.gif", &tex.saber},
+   {"robots.gif", &tex.robots},
+   {"wall.gif", &tex.wall},
+   {"boulder.gif", &tex.stone},
+   {"mirvattack.gif", &tex.effect},
+   {"mirv.gif", &tex.mirv},
+   {"ladder.gif", &tex.ladder},
+};
+
+// assets.pak, every picture, sound and room in one file so starting up
+// opens one file instead of thirty. it's mapped once and loaders get a
+// read-only RWops over their piece of it, nothing is copied out. a header,
+// then the index sorted by name, then each file's bytes on a PAK_ALIGN
+// boundary so compiled rooms can be read in place
+#define PAK_MAGIC 0x4b504a46
+#define PAK_VERSION 1
+#define PAK_NAME_MAX 64
+#define PAK_ALIGN 16
+#define PAK_FILE "assets.pak"
+
+struct pakentry {
+   char name[PAK_NAME_MAX];
+   // from the start of the pak
+   Uint32 offset;
+   Uint32 size;
+};
+
+struct pakheader {
+   Uint32 magic;
+   Uint32 version;
+   Uint32 size;
+   Uint32 count;
+};
+
+struct {
+   pakheader *head;
+   size_t size;
+   int mapped;
+   time_t mtime;
+   // 0 loads everything from loose files, pack or not
+   int on;
+} pak = {0, 0, 0, 0, 1};
+
+pakentry* pakEntries(pakheader *ph)
 {
-   SDL_Surface *lsrf = IMG_Load(file);
-   SDL_Texture *tex;
-   if (lsrf) {
-      tex = SDL_CreateTextureFromSurface(ren, lsrf);
+   return (pakentry*)(ph + 1);
+}
+
+int checkPak(pakheader *ph, size_t size)
+{
+   if (size < sizeof(pakheader) || ph->magic != PAK_MAGIC || ph->version != PAK_VERSION || ph->size != size ||
+         ph->count > (size - sizeof(pakheader)) / sizeof(pakentry)) {
+      return 0;
+   }
+   pakentry *pe = pakEntries(ph);
+   for (Uint32 i = 0; i < ph->count; i++) {
+      if (pe[i].name[PAK_NAME_MAX - 1] || pe[i].offset > size || pe[i].size > size - pe[i].offset) {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+void closePak()
+{
+#ifndef _WIN32
+   if (pak.mapped) {
+      munmap(pak.head, pak.size);
+      pak.head = 0;
+      return;
+   }
+#endif
+   free(pak.head);
+   pak.head = 0;
+}
+
+// leaves the pak closed if there isn't one, or it's from another build
+void openPak(const char *fname)
+{
+   struct stat st;
+   if (!pak.on || stat(fname, &st) != 0) {
+      return;
+   }
+   size_t size = st.st_size;
+   void *p = 0;
+   int mapped = 0;
+#ifdef _WIN32
+   SDL_RWops *rw = SDL_RWFromFile(fname, "rb");
+   if (rw) {
+      p = malloc(size);
+      if (SDL_RWread(rw, p, 1, size) != size) {
+         free(p);
+         p = 0;
+      }
+      SDL_RWclose(rw);
+   }
+#else
+   int fd = open(fname, O_RDONLY);
+   if (fd >= 0) {
+      p = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if (p == MAP_FAILED) {
+         p = 0;
+      }
+      mapped = (p != 0);
+   }
+#endif
+   pak.head = (pakheader*)p;
+   pak.size = size;
+   pak.mapped = mapped;
+   pak.mtime = st.st_mtime;
+   if (p && !checkPak(pak.head, size)) {
+      printf("%s: not a pak from this build, loading loose files\n", fname);
+      closePak();
+   }
+}
+
+int comparePakName(const void *key, const void *entry)
+{
+   return strcmp((const char*)key, ((const pakentry*)entry)->name);
+}
+
+// a loose file edited since the pak was built is loaded over the packed
+// one, so editing works the same with or without a pak. it's a stat, not
+// an open, so starting up still opens the one file
+int newerThanPak(const char *name)
+{
+   struct stat st;
+   return stat(name, &st) == 0 && st.st_mtime > pak.mtime;
+}
+
+// where name's bytes are in the pak, or 0 when it isn't packed or the
+// loose file is newer
+const void* findPacked(const char *name, size_t *size)
+{
+   if (!pak.head) {
+      return 0;
+   }
+   pakentry *pe = (pakentry*)bsearch(name, pakEntries(pak.head), pak.head->count, sizeof(pakentry), comparePakName);
+   if (!pe) {
+      return 0;
+   }
+   if (newerThanPak(name)) {
+      printf("%s is newer than %s, loading it instead\n", name, PAK_FILE);
+      return 0;
+   }
+   *size = pe->size;
+   return (const char*)pak.head + pe->offset;
+}
+
+// a RWops over name, out of the pak when it's in there and off disk when
+// it isn't. either way it's the loader's to close
+SDL_RWops* openAsset(const char *name)
+{
+   size_t size;
+   const void *p = findPacked(name, &size);
+   if (p) {
+      return SDL_RWFromConstMem(p, size);
+   }
+   return SDL_RWFromFile(name, "rb");
+}
+
+// the in-house software renderer, for boxes with no GPU where SDL would
+// fall back to its generic one. draws are recorded as a list of fills and
+// copies, then rasterized into a field_w x field_h buffer in the atlas's
+// pixel format, in horizontal bands that can go to different threads.
+// the buffer goes up to pixelbuffer in one SDL_UpdateTexture() a frame.
+// copies are 1:1, and a pixel with no alpha is a hole, anything else is
+// solid
+enum softop_types {
+   so_fill,
+   so_blit
+};
+
+struct softop {
+   int type;
+   Uint32 color;
+   const Uint32 *src;
+   int pitch;
+   int sx, sy;
+   SDL_Rect dst;
+   int flip;
+};
+
+struct {
+   int on;
+   // 1 rasterizes the whole frame on the calling thread
+   int bands;
+   Uint32 pixels[field_w * field_h];
+   softop *ops;
+   int op_count, op_max;
+   // cpu side copy of the sprite atlas
+   Uint32 *atlas;
+   int atlas_w, atlas_h;
+} soft;
+
+// a pixel in SDL_PIXELFORMAT_RGBA32, which is bytes in rgba order
+Uint32 softColor(Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+{
+   Uint8 bytes[4] = {r, g, b, a};
+   Uint32 res;
+   memcpy(&res, bytes, sizeof(res));
+   return res;
+}
+
+softop* pushSoftOp(int type)
+{
+   if (soft.op_count == soft.op_max) {
+      soft.op_max = max(soft.op_max * 2, 256);
+      soft.ops = (softop*)realloc(soft.ops, soft.op_max * sizeof(softop));
+   }
+   softop *op = soft.ops + soft.op_count++;
+   op->type = type;
+   return op;
+}
+
+void softFill(SDL_Rect *r, Uint32 color)
+{
+   softop *op = pushSoftOp(so_fill);
+   op->color = color;
+   op->dst = *r;
+}
+
+// a w x h block from (sx, sy) in a source image to (dx, dy) on screen.
+// the source has to stay put until the frame is rasterized
+void softBlit(const Uint32 *src, int pitch, int sx, int sy, int w, int h, int dx, int dy, int flip)
+{
+   softop *op = pushSoftOp(so_blit);
+   op->src = src;
+   op->pitch = pitch;
+   op->sx = sx;
+   op->sy = sy;
+   op->dst.x = dx;
+   op->dst.y = dy;
+   op->dst.w = w;
+   op->dst.h = h;
+   op->flip = flip;
+}
+
+// copies the solid pixels of n source pixels. flipped, src is the last
+// pixel of the run and the copy walks back from it
+void softBlitRow(Uint32 *dst, const Uint32 *src, int n, int flip)
+{
+   Uint32 amask = softColor(0, 0, 0, 255);
+   int i = 0;
+#ifdef WALL_LANES
+   __m128i am = _mm_set1_epi32(amask);
+   __m128i zero = _mm_setzero_si128();
+   for (; i + 4 <= n; i += 4) {
+      __m128i s;
+      if (flip) {
+         s = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(src - i - 3)), _MM_SHUFFLE(0, 1, 2, 3));
+      } else {
+         s = _mm_loadu_si128((const __m128i*)(src + i));
+      }
+      __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+      __m128i hole = _mm_cmpeq_epi32(_mm_and_si128(s, am), zero);
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_and_si128(hole, d), _mm_andnot_si128(hole, s)));
+   }
+#endif
+   for (; i < n; i++) {
+      Uint32 s = flip?src[-i]:src[i];
+      if (s & amask) {
+         dst[i] = s;
+      }
+   }
+}
+
+// draws one op, clipped to the screen and to rows [band_y0, band_y1)
+void rasterSoftOp(softop *op, int band_y0, int band_y1)
+{
+   int x0 = max(op->dst.x, 0);
+   int y0 = max(op->dst.y, band_y0);
+   int x1 = min(op->dst.x + op->dst.w, field_w);
+   int y1 = min(op->dst.y + op->dst.h, band_y1);
+   if (x0 >= x1 || y0 >= y1) {
+      return;
+   }
+   for (int y = y0; y < y1; y++) {
+      Uint32 *row = soft.pixels + y * field_w;
+      if (op->type == so_fill) {
+         for (int x = x0; x < x1; x++) {
+            row[x] = op->color;
+         }
+      } else {
+         const Uint32 *src = op->src + (op->sy + y - op->dst.y) * op->pitch;
+         if (op->flip) {
+            src += op->sx + op->dst.w - 1 - (x0 - op->dst.x);
+         } else {
+            src += op->sx + (x0 - op->dst.x);
+         }
+         softBlitRow(row + x0, src, x1 - x0, op->flip);
+      }
+   }
+}
+
+// every op in order, for one band of rows
+void rasterSoftBand(void *data, int band)
+{
+   int bands = *(int*)data;
+   int y0 = field_h * band / bands;
+   int y1 = field_h * (band + 1) / bands;
+   for (int i = 0; i < soft.op_count; i++) {
+      rasterSoftOp(soft.ops + i, y0, y1);
+   }
+}
+
+#define ATLAS_W 256
+
+// packs every picture into one texture, so sprites off different sheets
+// can go out in the same batch. shelf packed, tallest first, with a clear
+// pixel between pictures
+void loadAtlas()
+{
+   const int count = sizeof(atlas_files) / sizeof(atlas_files[0]);
+   SDL_Surface *surfaces[count];
+   int heights[count];
+   int order[count];
+   for (int i = 0; i < count; i++) {
+      // converting turns the gif's colour key into alpha
+      SDL_Surface *lsrf = IMG_Load_RW(openAsset(atlas_files[i].file), 1);
+      surfaces[i] = lsrf?SDL_ConvertSurfaceFormat(lsrf, SDL_PIXELFORMAT_RGBA32, 0):0;
       SDL_FreeSurface(lsrf);
+      heights[i] = surfaces[i]?surfaces[i]->h:0;
+      int j = i;
+      while (j > 0 && heights[order[j - 1]] < heights[i]) {
+         order[j] = order[j - 1];
+         j--;
+      }
+      order[j] = i;
+   }
+
+   SDL_Rect rects[count];
+   int x = 0;
+   int y = 0;
+   int shelf_h = 0;
+   for (int k = 0; k < count; k++) {
+      SDL_Surface *srf = surfaces[order[k]];
+      if (!srf) {
+         continue;
+      }
+      if (x + srf->w > ATLAS_W) {
+         x = 0;
+         y += shelf_h + 1;
+         shelf_h = 0;
+      }
+      SDL_Rect r = {x, y, srf->w, srf->h};
+      rects[order[k]] = r;
+      x += srf->w + 1;
+      shelf_h = max(shelf_h, srf->h);
+   }
+
+   SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_W, max(y + shelf_h, 1), 32, SDL_PIXELFORMAT_RGBA32);
+   for (int i = 0; i < count; i++) {
+      if (surfaces[i]) {
+         SDL_Rect dst = rects[i];
+         SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE);
+         SDL_BlitSurface(surfaces[i], 0, atlas, &dst);
+      }
    }
-   return tex;
+   SDL_Texture *atlas_tex = SDL_CreateTextureFromSurface(ren, atlas);
+   SDL_SetTextureBlendMode(atlas_tex, SDL_BLENDMODE_BLEND);
+   free(soft.atlas);
+   soft.atlas_w = atlas->w;
+   soft.atlas_h = atlas->h;
+   soft.atlas = (Uint32*)malloc(atlas->w * atlas->h * sizeof(Uint32));
+   for (int row = 0; row < atlas->h; row++) {
+      memcpy(soft.atlas + row * atlas->w, (Uint8*)atlas->pixels + row * atlas->pitch, atlas->w * sizeof(Uint32));
+   }
+   SDL_FreeSurface(atlas);
+   for (int i = 0; i < count; i++) {
+      if (surfaces[i]) {
+         atlas_files[i].image->tex = atlas_tex;
+         atlas_files[i].image->rect = rects[i];
+         SDL_FreeSurface(surfaces[i]);
+      }
+   }
+}
+
+// sprite quads waiting to go out in one SDL_RenderGeometry() call. the
+// batch flushes itself when the texture changes, anything drawn some
+// other way has to flushSprites() first so it lands in the right order
+struct {
+   SDL_Texture *tex;
+   float tex_w, tex_h;
+   SDL_Vertex *verts;
+   int *indices;
+   int count, max;
+} sprites;
+
+void flushSprites()
+{
+   if (sprites.count) {
+      SDL_RenderGeometry(ren, sprites.tex, sprites.verts, sprites.count * 4, sprites.indices, sprites.count * 6);
+      sprites.count = 0;
+   }
+}
+
+// queues a copy of src to dst, flip mirrors it by swapping the u coords
+void batchSprite(SDL_Texture *t, SDL_Rect *src, SDL_Rect *dst, int flip)
+{
+   if (!t) {
+      return;
+   }
+   if (soft.on) {
+      softBlit(soft.atlas, soft.atlas_w, src->x, src->y, src->w, src->h, dst->x, dst->y, flip);
+      return;
+   }
+   if (t != sprites.tex) {
+      flushSprites();
+      int w, h;
+      SDL_QueryTexture(t, 0, 0, &w, &h);
+      sprites.tex = t;
+      sprites.tex_w = w;
+      sprites.tex_h = h;
+   }
+   if (sprites.count == sprites.max) {
+      int old = sprites.max;
+      sprites.max = max(old * 2, 256);
+      sprites.verts = (SDL_Vertex*)realloc(sprites.verts, sprites.max * 4 * sizeof(SDL_Vertex));
+      sprites.indices = (int*)realloc(sprites.indices, sprites.max * 6 * sizeof(int));
+      for (int q = old; q < sprites.max; q++) {
+         int *ind = sprites.indices + q * 6;
+         ind[0] = q * 4;
+         ind[1] = ind[4] = q * 4 + 1;
+         ind[2] = ind[3] = q * 4 + 2;
+         ind[5] = q * 4 + 3;
+      }
+   }
+   float u0 = src->x / sprites.tex_w;
+   float u1 = (src->x + src->w) / sprites.tex_w;
+   float v0 = src->y / sprites.tex_h;
+   float v1 = (src->y + src->h) / sprites.tex_h;
+   if (flip) {
+      float u = u0;
+      u0 = u1;
+      u1 = u;
+   }
+   SDL_Color white = {255, 255, 255, 255};
+   SDL_Vertex *v = sprites.verts + sprites.count * 4;
+   for (int i = 0; i < 4; i++) {
+      v[i].color = white;
+      v[i].position.x = dst->x + ((i & 1)?dst->w:0);
+      v[i].position.y = dst->y + ((i & 2)?dst->h:0);
+      v[i].tex_coord.x = (i & 1)?u1:u0;
+      v[i].tex_coord.y = (i & 2)?v1:v0;
+   }
+   sprites.count++;
+}
+
+void clearScreen(Uint8 r, Uint8 g, Uint8 b)
+{
+   if (soft.on) {
+      SDL_Rect all = {0, 0, field_w, field_h};
+      softFill(&all, softColor(r, g, b, 255));
+      return;
+   }
+   SDL_SetRenderDrawColor(ren, r, g, b, 255);
+   SDL_RenderClear(ren);
+}
+
+void fillScreenRect(SDL_Rect *rect, Uint8 r, Uint8 g, Uint8 b)
+{
+   if (soft.on) {
+      softFill(rect, softColor(r, g, b, 255));
+      return;
+   }
+   flushSprites();
+   SDL_SetRenderDrawColor(ren, r, g, b, 255);
+   SDL_RenderFillRect(ren, rect);
+}
+
+void outlineScreenRect(SDL_Rect *rect, Uint8 r, Uint8 g, Uint8 b)
+{
+   if (soft.on) {
+      Uint32 color = softColor(r, g, b, 255);
+      SDL_Rect edge = {rect->x, rect->y, rect->w, 1};
+      softFill(&edge, color);
+      edge.y = rect->y + rect->h - 1;
+      softFill(&edge, color);
+      edge.y = rect->y;
+      edge.w = 1;
+      edge.h = rect->h;
+      softFill(&edge, color);
+      edge.x = rect->x + rect->w - 1;
+      softFill(&edge, color);
+      return;
+   }
+   flushSprites();
+   SDL_SetRenderDrawColor(ren, r, g, b, 255);
+   SDL_RenderDrawRect(ren, rect);
 }
 
 Uint64 secondsToPCF(float seconds)
@@ -136,6 +670,171 @@ Uint64 secondsToPCF(float seconds)
    return SDL_GetPerformanceFrequency() * seconds;
 }
 
+// frame profiler. a stage takes the time with profBegin() and hands it to
+// profEnd() on its way out, which drops the stage's time into a ring that
+// any thread can write to without a lock: a writer takes its slot with one
+// atomic add. the main thread drains the ring once a frame, between frames
+// when no stage is running. while the profiler is off a stage costs a
+// branch, and building with -DNO_PROFILER takes the timing out entirely
+enum profmarkers {
+   prof_events,
+   prof_player,
+   prof_shots,
+   prof_enemies,
+   prof_mirv,
+   prof_tilemap,
+   prof_ladders,
+   prof_draw_enemies,
+   prof_effects,
+   prof_raster,
+   prof_present,
+   prof_marker_count
+};
+
+const char *prof_names[prof_marker_count] = {
+   "events", "tickPlayer", "stepPshots", "tickEnemies", "tickMirv",
+   "drawTilemap", "drawLadders", "drawEnemies", "drawEffects", "raster",
+   "present"
+};
+
+// has to be a power of 2
+#define PROF_RING 8192
+// how much frame time the overlay's bars fill the screen with
+#define PROF_OVERLAY_US 16667
+
+struct profrecord {
+   int marker;
+   int frame;
+   unsigned long thread;
+   Uint64 start;
+   Uint64 end;
+};
+
+struct {
+   int on;
+   int overlay;
+   int frame;
+   profrecord ring[PROF_RING];
+   SDL_atomic_t head;
+   int tail;
+   // records written over before they were drained
+   int dropped;
+   Uint64 origin;
+   // per marker time in the last frame drained, for the overlay
+   Uint64 last[prof_marker_count];
+   FILE *csv;
+   FILE *trace;
+   int traced;
+} prof;
+
+void profRecord(int marker, Uint64 start)
+{
+   int n = SDL_AtomicAdd(&prof.head, 1);
+   profrecord *r = prof.ring + (n & (PROF_RING - 1));
+   r->marker = marker;
+   r->frame = prof.frame;
+   r->thread = SDL_ThreadID();
+   r->start = start;
+   r->end = SDL_GetPerformanceCounter();
+}
+
+Uint64 profBegin()
+{
+#ifdef NO_PROFILER
+   return 0;
+#else
+   return prof.on?SDL_GetPerformanceCounter():0;
+#endif
+}
+
+void profEnd(int marker, Uint64 start)
+{
+   if (start) {
+      profRecord(marker, start);
+   }
+}
+
+void startProfiler(const char *csv, const char *trace)
+{
+   prof.origin = SDL_GetPerformanceCounter();
+   if (csv) {
+      prof.csv = fopen(csv, "w");
+      if (prof.csv) {
+         fprintf(prof.csv, "frame,marker,thread,start_us,duration_us\n");
+      }
+   }
+   if (trace) {
+      prof.trace = fopen(trace, "w");
+      if (prof.trace) {
+         fprintf(prof.trace, "{\"traceEvents\":[\n");
+      }
+   }
+   prof.on = prof.overlay || prof.csv || prof.trace;
+}
+
+// takes everything out of the ring and starts the next frame
+void drainProfiler()
+{
+   double us = 1e6 / SDL_GetPerformanceFrequency();
+   int head = SDL_AtomicGet(&prof.head);
+   if (head - prof.tail > PROF_RING) {
+      prof.dropped += head - prof.tail - PROF_RING;
+      prof.tail = head - PROF_RING;
+   }
+   memset(prof.last, 0, sizeof(prof.last));
+   for (; prof.tail != head; prof.tail++) {
+      profrecord *r = prof.ring + (prof.tail & (PROF_RING - 1));
+      if (r->frame == prof.frame) {
+         prof.last[r->marker] += r->end - r->start;
+      }
+      double start = (r->start - prof.origin) * us;
+      double took = (r->end - r->start) * us;
+      if (prof.csv) {
+         fprintf(prof.csv, "%d,%s,%lu,%.3f,%.3f\n", r->frame, prof_names[r->marker], r->thread, start, took);
+      }
+      if (prof.trace) {
+         fprintf(prof.trace, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%d}}",
+               prof.traced++?",\n":"", prof_names[r->marker], r->thread, start, took, r->frame);
+      }
+   }
+   prof.frame++;
+}
+
+void stopProfiler()
+{
+   drainProfiler();
+   if (prof.csv) {
+      fclose(prof.csv);
+   }
+   if (prof.trace) {
+      fprintf(prof.trace, "\n]}\n");
+      fclose(prof.trace);
+   }
+   if (prof.dropped) {
+      printf("profiler ring overflowed, %d records lost\n", prof.dropped);
+   }
+   prof.on = 0;
+}
+
+// a bar per marker down the left of the screen, one frame's worth of time
+// across the whole width
+void drawProfOverlay()
+{
+   static const Uint8 colors[prof_marker_count][3] = {
+      {255, 255, 255}, {0, 160, 255}, {0, 255, 255}, {255, 64, 64},
+      {255, 160, 0}, {64, 255, 64}, {160, 255, 160}, {255, 128, 128},
+      {255, 255, 0}, {192, 128, 255}, {255, 0, 255}
+   };
+   SDL_Rect back = {2, 2, field_w - 4, prof_marker_count * 4 + 2};
+   fillScreenRect(&back, 0, 0, 0);
+   for (int i = 0; i < prof_marker_count; i++) {
+      double us = prof.last[i] * 1e6 / SDL_GetPerformanceFrequency();
+      SDL_Rect bar = {3, 3 + i * 4, (int)(us * (field_w - 6) / PROF_OVERLAY_US), 3};
+      bar.w = min(max(bar.w, 1), field_w - 6);
+      fillScreenRect(&bar, colors[i][0], colors[i][1], colors[i][2]);
+   }
+}
+
 inline
 float fapproach(float a, float t, float step)
 {
@@ -256,88 +955,699 @@ struct rect {
    float x, y, w, h;
 };
 
-int pointInRect(v2 *v, rect *r)
-{
-   return ((v->x >= r->x) && (v->y >= r->y) && (v->x <= r->x + r->w) && (v->y <= r->y + r->h));
-}
+// 16.16 fixed point versions of v2 and rect for the fixed point wall sweep
+typedef int fixed;
+#define FX_ONE 65536
 
-int pointInRect(float x, float y, rect *r)
-{
-   return ((x >= r->x) && (y >= r->y) && (x <= r->x + r->w) && (y <= r->y + r->h));
-}
+struct fv2 {
+   fixed x, y;
+};
 
-struct {
-   rect bounds;
-   v2 position;
-} camera;
+struct frect {
+   fixed x, y, w, h;
+};
 
-inline
-SDL_Rect rectToSDLRect(rect *r)
+fixed toFixed(float f)
 {
-   SDL_Rect crect = {
-      floor(r->x),
-      floor(r->y),
-      floor(r->w),
-      floor(r->h)
-   };
-   return crect;
+   return (fixed)floor(f * 65536.0 + 0.5);
 }
 
-void drawRect(SDL_Renderer *ren, rect *r)
+float fromFixed(fixed f)
 {
-   SDL_Rect crect = rectToSDLRect(r);
-   crect.x -= camera.position.x;
-   crect.y -= camera.position.y;
-   SDL_RenderDrawRect(ren, &crect);
+   return f / 65536.f;
 }
 
-void fillRect(SDL_Renderer *ren, rect *r)
+fixed fxabs(fixed a)
 {
-   SDL_Rect crect = rectToSDLRect(r);
-   crect.x -= camera.position.x;
-   crect.y -= camera.position.y;
-   SDL_RenderFillRect(ren, &crect);
+   return (a < 0)?-a:a;
 }
 
-#define ROOM_CONNECTION_MAX 9
-#define RC_FILE_MAX 20
-struct {
-   rect bounds;
-   rect connections[ROOM_CONNECTION_MAX];
-   char roomname[RC_FILE_MAX];
-   char filenames[ROOM_CONNECTION_MAX][RC_FILE_MAX];
-   v2 transition_offset;
-   int connection_count;
-} room;
-
-int rectInRoom(rect *r)
+fixed fxmul(fixed a, fixed b)
 {
-   return (r->x <= room.bounds.w && r->y <= room.bounds.h && r->x + r->w >= 0 && r->y + r->h >= 0);
+   return (fixed)(((long long)a * b) >> 16);
 }
 
-void setRoomName(const char* nname)
+// quotients are only ever compared against 0..1, so clamp instead of overflowing
+fixed fxdiv(fixed a, fixed b)
 {
-   int size = strlen(nname);
-   size = (size < RC_FILE_MAX)?size:RC_FILE_MAX;
-   strncpy(room.roomname, nname, size);
-   room.roomname[size] = 0;
-   //printf("filename is %s\n", room.roomname);
+   long long res = ((long long)a * FX_ONE) / b;
+   if (res > (1 << 30)) {
+      return 1 << 30;
+   }
+   if (res < -(1 << 30)) {
+      return -(1 << 30);
+   }
+   return (fixed)res;
 }
 
-void resetConnections()
+frect toFixedRect(rect *r)
 {
-   rect rs = {};
-   for (int i = 0; i < ROOM_CONNECTION_MAX; i++) {
-      room.connections[i] = rs;
-      room.filenames[i][0] = 0;
-   }
+   frect res = {toFixed(r->x), toFixed(r->y), toFixed(r->w), toFixed(r->h)};
+   return res;
 }
 
-void drawConnections()
+int pointInRect(v2 *v, rect *r)
+{
+   return ((v->x >= r->x) && (v->y >= r->y) && (v->x <= r->x + r->w) && (v->y <= r->y + r->h));
+}
+
+int pointInRect(float x, float y, rect *r)
+{
+   return ((x >= r->x) && (y >= r->y) && (x <= r->x + r->w) && (y <= r->y + r->h));
+}
+
+// game state. everything one running game owns lives in a world, so any
+// number of them can be stepped side by side on different threads
+
+struct camera_s {
+   rect bounds;
+   v2 position;
+   v2 prev_position;
+   // where render() is drawing from, between the last two steps
+   v2 view;
+};
+
+#define ROOM_CONNECTION_MAX 9
+#define RC_FILE_MAX 20
+struct room_s {
+   rect bounds;
+   rect connections[ROOM_CONNECTION_MAX];
+   char roomname[RC_FILE_MAX];
+   char filenames[ROOM_CONNECTION_MAX][RC_FILE_MAX];
+   v2 transition_offset;
+   int connection_count;
+};
+
+// a room compiled out of its text, with the walls already merged and
+// everything else the text's characters stood for pulled out into records.
+// it's laid out exactly like a .room file, so a file mapped off disk is read
+// in place. a .txt with no .room, or a newer one, compiles to the same layout
+// in memory
+#define ROOMFILE_MAGIC 0x4d524a46
+#define ROOMFILE_VERSION 1
+
+// in tiles
+struct roomrect {
+   Sint32 x, y, w, h;
+};
+
+struct roomspawn {
+   // the character it stood for in the text
+   Sint32 kind;
+   // how many of the room's walls are made before it. boulders make a wall
+   // of their own, and walls have to come out in the order the text had them
+   Sint32 walls;
+   float x, y;
+};
+
+struct roomfile {
+   Uint32 magic;
+   Uint32 version;
+   Uint32 size;
+   Sint32 screens_w, screens_h;
+   Sint32 connection_count;
+   char filenames[ROOM_CONNECTION_MAX][RC_FILE_MAX];
+   // w is 0 for connections the room doesn't have
+   rect connections[ROOM_CONNECTION_MAX];
+   // how many tile images the tiles were picked from. a tileset with a
+   // different count has them picked again at load
+   Sint32 tile_samples;
+   Sint32 wall_count, ladder_count, spawn_count, tile_count;
+   // offsets from the start of the file
+   Uint32 walls, ladders, spawns, tiles;
+};
+
+// where a roommap's room lives, so closing it knows what to give back
+enum roommappings {
+   rm_heap,
+   rm_mapped,
+   // inside the pak, which owns it
+   rm_packed,
+};
+
+// a room ready to go into a world, mapped off disk, in the pak or compiled
+struct roommap {
+   roomfile *room;
+   size_t size;
+   int mapped;
+};
+
+// rooms a world has been in, kept so walking back into one, or resetting,
+// doesn't go back to the disk. each world has its own, so batch worlds on
+// different threads never share one
+#define ROOM_CACHE_MAX 32
+
+struct cachedroom {
+   char name[RC_FILE_MAX];
+   roommap map;
+   unsigned used;
+};
+
+struct roomcache_s {
+   cachedroom rooms[ROOM_CACHE_MAX];
+   int count;
+   size_t bytes;
+   // bumped on every use, the least recently used room goes first
+   unsigned clock;
+   int hits;
+   int misses;
+};
+
+// bytes of rooms a world keeps, 0 turns the cache off
+size_t room_cache_budget = 256 * 1024;
+// whether the game loads the rooms next door ahead of time
+int room_prefetch = 1;
+SDL_atomic_t room_loads;
+// --stream, keep the rooms next door loaded and running alongside
+int stream_rooms;
+
+struct ladder {
+   rect bounds;
+};
+
+// each ladder is filed under the tile column its left edge sits in
+struct ladderindex_s {
+   int *cols;
+   int *items;
+   int col_count;
+   int max_w;
+};
+
+struct tilemap_s {
+   char *data;
+   unsigned char *solid;
+   atlasimage tex;
+   int width, height;
+   int size;
+   int tex_pitch;
+   int tex_samplecount;
+   // the tile pattern draws from its own stream, seeded by the room size,
+   // so a room always looks the same however the game's stream is going
+   unsigned int rng;
+};
+
+// the screens of the room the camera can see, worked out off the render
+// thread while the rest of the frame ticks. the camera is one screen big,
+// so it can't see more than four
+struct tilelist_s {
+   int screens[4];
+   SDL_Rect dst[4];
+   int count;
+   // what the list was built for, render() rebuilds it if these changed
+   int loads;
+   v2 camera;
+};
+
+// one screen of a room's tiles, drawn into a texture the first time it's
+// seen so the tilemap is a copy per visible screen instead of per tile
+struct tilechunk {
+   SDL_Texture *tex;
+   // what the software renderer bakes into instead
+   Uint32 *pixels;
+   // the screen in tex and the load it's from, -1 when it holds nothing
+   int screen;
+   int loads;
+   // when it was last drawn, the oldest is rebaked first
+   unsigned int used;
+};
+
+// chunks belong to the renderer, so they're shared by whichever world is
+// drawn. the budget keeps huge rooms from baking a texture per screen
+int tilechunk_budget = 16;
+tilechunk *tilechunks;
+int tilechunk_count;
+unsigned int tilechunk_clock;
+int tilechunk_bakes;
+
+struct wall {
+   rect bounds;
+   int active;
+   int fromtiles;
+};
+
+// rooms can have as many walls as they like, the pool grows this many at a time
+#define WALL_CHUNK 512
+
+// uniform grid over the room, cells hold indices of the active walls touching them
+#define WALLGRID_CELL 32
+#define WALLGRID_SHIFT 5
+
+struct wallgrid_s {
+   int *cells;
+   int *items;
+   int cell_w, cell_h;
+   int dirty;
+};
+
+// scratch for gathering walls out of the grid. enemy jobs sweep against the
+// same world from several threads at once, so each thread gets its own.
+// it grows to fit the biggest wall pool the thread has gathered from. pool
+// workers give theirs back when they quit, the main thread at exit
+struct wallquery_s {
+   int query;
+   int cap;
+   int *stamp;
+   int *found;
+};
+
+thread_local wallquery_s wallquery;
+
+void releaseWallQuery()
+{
+   free(wallquery.stamp);
+   free(wallquery.found);
+   memset(&wallquery, 0, sizeof(wallquery));
+}
+
+// structure-of-arrays mirror of the wall pool for the batched slab test,
+// grown along with the pool
+struct wallsoa_s {
+   float *x;
+   float *y;
+   float *w;
+   float *h;
+   int *active;
+   frect *fixedbounds;
+   int cap;
+};
+
+struct asprite {
+   SDL_Texture *tex;
+   // where the sheet starts in the atlas
+   int x, y;
+   int framecount;
+   int pitch;
+   int w, h;
+};
+
+struct effect {
+   asprite spr;
+   v2 offset;
+   v2 position;
+   v2 prev_position;
+   v2 velocity;
+   int timer;
+   int timer_start;
+   int frame_start;
+   int frame_end;
+};
+
+struct p_shot {
+   rect worldbounds;
+   asprite spr;
+   v2 position;
+   v2 prev_position;
+   v2 velocity;
+   int last_bounds_frame;
+   // hit something, the next stepPshots() drops it
+   int spent;
+};
+
+struct player {
+   v2 position;
+   // where the last step left it, render() draws in between
+   v2 prev_position;
+   v2 velocity;
+   rect worldbounds;
+   float w, h;
+   float frame;
+   asprite spr;
+   int active;
+   int flip;
+   int alive;
+   int jumping;
+   int onladder;
+   int accept_ladder;
+   int last_bounds_frame;
+   int hitpoints;
+   int hurt_timer;
+};
+
+struct boulderboss {
+   handle blocker;
+   v2 prev_position;
+   asprite spr;
+   int hitpoints;
+   int shot_hit;
+};
+
+// the small mobs keep their simulation state split per field, tickEnemies()
+// walks the hot columns and only drawEnemies() reads the cold one
+struct mobsprite {
+   asprite spr;
+   float frame;
+};
+
+#define MOB_ACTIVE   1
+#define MOB_FLIP     2
+#define MOB_FLIPPING 4
+
+#define dozer_columns(X) \
+   X(v2, position) \
+   X(v2, prev_position) \
+   X(v2, velocity) \
+   X(int, hitpoints) \
+   X(int, state_timer) \
+   X(int, shot_hit) \
+   X(unsigned char, flags) \
+   X(mobsprite, cold)
+
+soa_create(dozerset, dozer_columns)
+
+#define bullet_columns(X) \
+   X(v2, position) \
+   X(v2, prev_position) \
+   X(v2, velocity) \
+   X(float, altitude) \
+   X(int, hitpoints) \
+   X(int, shot_hit) \
+   X(unsigned char, flags) \
+   X(mobsprite, cold)
+
+soa_create(bulletset, bullet_columns)
+
+#define saucer_columns(X) \
+   X(v2, position) \
+   X(v2, prev_position) \
+   X(v2, seek_vel) \
+   X(int, state_timer) \
+   X(int, hitpoints) \
+   X(int, shot_hit) \
+   X(unsigned char, flags) \
+   X(mobsprite, cold)
+
+soa_create(saucerset, saucer_columns)
+
+#define spider_columns(X) \
+   X(v2, position) \
+   X(v2, prev_position) \
+   X(int, shot_timer) \
+   X(int, hitpoints) \
+   X(int, shot_hit) \
+   X(unsigned char, flags) \
+   X(mobsprite, cold)
+
+soa_create(spiderset, spider_columns)
+
+struct slaser {
+   asprite spr;
+   v2 position;
+   v2 prev_position;
+   float hspeed;
+};
+
+struct item {
+   asprite spr;
+   v2 position;
+   v2 prev_position;
+   int healamt;
+   int frame[2];
+   int timer;
+};
+
+struct mirvrocket {
+   asprite spr;
+   v2 position;
+   v2 prev_position;
+   int direction;
+   v2 velocity;
+};
+
+struct mirv_s {
+   asprite spr;
+   v2 position;
+   v2 prev_position;
+   int active;
+   int state; 
+   int timer;
+   int hurttimer;
+   int hitpoints;
+   int flip;
+   float frame;
+   float orbit;
+   v2 velocity;
+   int shot_hit;
+};
+
+struct hittable {
+   rect bounds;
+   int *shot_hit;
+};
+
+struct sweepentry {
+   float minx, maxx;
+   int shot;
+   int slot;
+};
+
+struct shotpair {
+   int slot;
+   int shot;
+};
+
+struct shothits_s {
+   hittable *items;
+   sweepentry *entries;
+   shotpair *pairs;
+   int *active_shots;
+   int *active_slots;
+   int *perm;
+   char *spent;
+   int count, max;
+   int pair_count, pair_max;
+   int perm_max;
+   int shot_max;
+};
+
+// enemy jobs run on worker threads and can't touch anything shared, so the
+// things they do to the rest of the world are written down as commands and
+// carried out on the calling thread afterwards, job by job in a fixed order
+enum enemycmd_types {
+   ec_sound,
+   ec_smalldie,
+   ec_explode,
+   ec_drop,
+   ec_laser,
+   ec_spend_shot,
+   ec_hurt_player
+};
+
+struct enemycmd {
+   int type;
+   v2 position;
+   // knockback for ec_hurt_player, x is the speed for ec_laser
+   v2 velocity;
+   // damage for ec_hurt_player, shot index for ec_spend_shot
+   int amount;
+   Mix_Chunk *sound;
+};
+
+struct cmdbuffer {
+   enemycmd *items;
+   int count, max;
+};
+
+struct enemyjob;
+typedef void (*enemytick)(world *wd, enemyjob *job);
+
+// one archetype, or one slice of a big mob set, ticked by a single job
+struct enemyjob {
+   enemytick tick;
+   int start, end;
+   // taken once before the jobs start, nothing moves the player meanwhile
+   rect playerbounds;
+   cmdbuffer cmds;
+};
+
+struct threadpool;
+struct taskgraph;
+struct roomloader;
+
+// the shot cap can be raised from the command line for stress runs
+int max_shots = 3;
+
+struct world {
+   int frame;
+   unsigned long long rng;
+   camera_s camera;
+   room_s room;
+   tilemap_s tilemap;
+   tilelist_s tilelist;
+   // bumped by every loadLevel()
+   int loads;
+   // loads as of the last step, and how far render() is from that step
+   // to the next one
+   int prev_loads;
+   float alpha;
+   // ladders grow on demand, so rooms can have as many as they like
+   pool<ladder, 64> ladders;
+   ladderindex_s ladderindex;
+   pool<wall, WALL_CHUNK> walls;
+   wallgrid_s wallgrid;
+   wallsoa_s wallsoa;
+   int phys_mismatches;
+   player p1;
+   pool<p_shot, 64> pshots;
+   pool<effect, 32> effects;
+   pool<boulderboss, 1> boulders;
+   dozerset dozers;
+   bulletset bullets;
+   saucerset saucers;
+   spiderset spiders;
+   pool<slaser, 32> slasers;
+   pool<item, 8> items;
+   pool<mirvrocket, 512> mirvrs;
+   mirv_s mirv;
+   shothits_s shothits;
+   // 0 ticks the enemy jobs one after another on the calling thread
+   threadpool *jobs;
+   enemyjob *enemyjobs;
+   int enemyjob_count, enemyjob_max;
+   // simulate()'s stages, built on the first step
+   taskgraph *pipeline;
+   roomcache_s rooms;
+   // 0 loads every room on the thread that asks for it
+   roomloader *loader;
+   // set for the rooms of a streamed world. a neighbour is a room next door
+   // to the player's, with only a copy of the player in it
+   int streamed;
+   int neighbour;
+   // a streamed room doesn't load the room the player walks into, it leaves
+   // the connection here for simulateStream()
+   int exit_connection;
+};
+
+// zeroed world with its random stream seeded, load a level into it next
+world* createWorld(unsigned long long seed)
+{
+   world *wd = (world*)calloc(1, sizeof(world));
+   wd->pshots.limit = max_shots;
+   wd->effects.limit = 32;
+   wd->boulders.limit = 1;
+   wd->dozers.limit = 16;
+   wd->bullets.limit = 16;
+   wd->saucers.limit = 16;
+   wd->spiders.limit = 16;
+   wd->slasers.limit = 32;
+   wd->items.limit = 8;
+   wd->mirvrs.limit = 512;
+   wd->rng = seed;
+   wd->alpha = 1;
+   return wd;
+}
+
+void releaseRoomCache(roomcache_s *rc);
+void destroyRoomLoader(roomloader *rl);
+
+void destroyWorld(world *wd)
+{
+   if (wd->loader) {
+      destroyRoomLoader(wd->loader);
+   }
+   free(wd->tilemap.data);
+   free(wd->tilemap.solid);
+   free(wd->ladderindex.cols);
+   free(wd->ladderindex.items);
+   free(wd->wallgrid.cells);
+   free(wd->wallgrid.items);
+   free(wd->wallsoa.x);
+   free(wd->wallsoa.y);
+   free(wd->wallsoa.w);
+   free(wd->wallsoa.h);
+   free(wd->wallsoa.active);
+   free(wd->wallsoa.fixedbounds);
+   free(wd->shothits.items);
+   free(wd->shothits.entries);
+   free(wd->shothits.pairs);
+   free(wd->shothits.active_shots);
+   free(wd->shothits.active_slots);
+   free(wd->shothits.perm);
+   free(wd->shothits.spent);
+   for (int i = 0; i < wd->enemyjob_max; i++) {
+      free(wd->enemyjobs[i].cmds.items);
+   }
+   free(wd->enemyjobs);
+   free(wd->pipeline);
+   releaseRoomCache(&wd->rooms);
+   wd->ladders.release();
+   wd->walls.release();
+   wd->pshots.release();
+   wd->effects.release();
+   wd->boulders.release();
+   wd->dozers.release();
+   wd->bullets.release();
+   wd->saucers.release();
+   wd->spiders.release();
+   wd->slasers.release();
+   wd->items.release();
+   wd->mirvrs.release();
+   free(wd);
+}
+
+// per world stand-in for rand(), so worlds on different threads don't share
+// one generator and a seed replays the same game
+int worldRand(world *wd)
+{
+   wd->rng = wd->rng * 6364136223846793005ULL + 1442695040888963407ULL;
+   return (int)(wd->rng >> 33);
+}
+
+inline
+SDL_Rect rectToSDLRect(rect *r)
+{
+   SDL_Rect crect = {
+      floor(r->x),
+      floor(r->y),
+      floor(r->w),
+      floor(r->h)
+   };
+   return crect;
+}
+
+void drawRect(world *wd, SDL_Renderer *ren, rect *r)
+{
+   SDL_Rect crect = rectToSDLRect(r);
+   crect.x -= wd->camera.view.x;
+   crect.y -= wd->camera.view.y;
+   SDL_RenderDrawRect(ren, &crect);
+}
+
+void fillRect(world *wd, SDL_Renderer *ren, rect *r)
+{
+   SDL_Rect crect = rectToSDLRect(r);
+   crect.x -= wd->camera.view.x;
+   crect.y -= wd->camera.view.y;
+   SDL_RenderFillRect(ren, &crect);
+}
+
+int rectInRoom(world *wd, rect *r)
+{
+   return (r->x <= wd->room.bounds.w && r->y <= wd->room.bounds.h && r->x + r->w >= 0 && r->y + r->h >= 0);
+}
+
+void setRoomName(world *wd, const char* nname)
+{
+   int size = strlen(nname);
+   size = (size < RC_FILE_MAX)?size:RC_FILE_MAX;
+   strncpy(wd->room.roomname, nname, size);
+   wd->room.roomname[size] = 0;
+   //printf("filename is %s\n", wd->room.roomname);
+}
+
+void resetConnections(world *wd)
+{
+   rect rs = {};
+   for (int i = 0; i < ROOM_CONNECTION_MAX; i++) {
+      wd->room.connections[i] = rs;
+      wd->room.filenames[i][0] = 0;
+   }
+}
+
+void drawConnections(world *wd)
 {
    SDL_SetRenderDrawColor(ren, 0, 100, 0, 255);
    for (int i = 0; i < ROOM_CONNECTION_MAX; i++) {
-      drawRect(ren, room.connections + i);
+      drawRect(wd, ren, wd->room.connections + i);
    }
 }
 
@@ -500,35 +1810,56 @@ int clipMovingRects(rect *a, v2 *da, rect *b, v2 *db, v2 *n, float *t)
    return 0;
 }
 
-void setCameraFocus(v2 * p)
+void setCameraFocus(world *wd, v2 * p)
 {
    v2 tpos;
-   tpos.x = fmin(fmax(camera.bounds.x, floor(p->x - field_w / 2)), camera.bounds.x + camera.bounds.w);
-   tpos.y = fmin(fmax(camera.bounds.y, floor(p->y - field_h / 2)), camera.bounds.y + camera.bounds.h);
-   camera.position = tpos;
+   tpos.x = fmin(fmax(wd->camera.bounds.x, floor(p->x - field_w / 2)), wd->camera.bounds.x + wd->camera.bounds.w);
+   tpos.y = fmin(fmax(wd->camera.bounds.y, floor(p->y - field_h / 2)), wd->camera.bounds.y + wd->camera.bounds.h);
+   wd->camera.position = tpos;
 }
 
-void setCameraFocus(float x, float y)
+void setCameraFocus(world *wd, float x, float y)
 {
    v2 r = makev2(x, y);
-   setCameraFocus(&r);
+   setCameraFocus(wd, &r);
 }
 
-int rectOnScreen(rect *r)
+int rectOnScreen(world *wd, rect *r)
 {
-   return (r->x + r->w > camera.position.x && r->y + r->h > camera.position.y &&
-         r->x < camera.position.x + field_w && r->y < camera.position.y + field_h);
+   return (r->x + r->w > wd->camera.position.x && r->y + r->h > wd->camera.position.y &&
+         r->x < wd->camera.position.x + field_w && r->y < wd->camera.position.y + field_h);
 }
 
-struct ladder {
-   rect bounds;
-};
+// rectOnScreen() for what render() is drawing
+int rectInView(world *wd, rect *r)
+{
+   return (r->x + r->w > wd->camera.view.x && r->y + r->h > wd->camera.view.y &&
+         r->x < wd->camera.view.x + field_w && r->y < wd->camera.view.y + field_h);
+}
+
+// anything that moved further than this in a step was spawned or teleported,
+// and is drawn where it is instead of sliding there
+#define INTERP_SNAP 48
+
+// where to draw something that was at prev after the last step but one
+// and is at cur now
+v2 interp(world *wd, v2 prev, v2 cur)
+{
+   v2 d = cur - prev;
+   if (wd->prev_loads != wd->loads || fabs(d.x) > INTERP_SNAP || fabs(d.y) > INTERP_SNAP) {
+      return cur;
+   }
+   return prev + d * wd->alpha;
+}
 
-tc_create(ladder, ladder, 64);
+struct ladderfacts {
+   ladder *touching;
+   int onpoint;
+};
 
-void createTileAlignedLadder(int x, int y, int w, int h)
+void createTileAlignedLadder(world *wd, int x, int y, int w, int h)
 {
-   ladder *l = tc_new(ladder);
+   ladder *l = wd->ladders.add();
    if (l) {
       l->bounds.x = x * tile_size;
       l->bounds.y = y * tile_size;
@@ -537,67 +1868,288 @@ void createTileAlignedLadder(int x, int y, int w, int h)
    }
 }
 
-ladder* getIntersectingLadder(rect *mr)
+void buildLadderIndex(world *wd)
 {
-   for (int i = 0; i < countof(ladder); i++) {
-      ladder *l = tc_at(ladder, i);
-      if (rectsOverlap(mr, &l->bounds)) {
-         return l;
-      }
+   free(wd->ladderindex.cols);
+   free(wd->ladderindex.items);
+   wd->ladderindex.col_count = max((int)ceil(wd->room.bounds.w / tile_size), 1);
+   wd->ladderindex.cols = (int*)calloc(wd->ladderindex.col_count + 1, sizeof(int));
+   wd->ladderindex.items = (int*)malloc(max(wd->ladders.count, 1) * sizeof(int));
+   wd->ladderindex.max_w = 0;
+   for (int i = 0; i < wd->ladders.count; i++) {
+      ladder *l = wd->ladders.at(i);
+      int c = min(max((int)floor(l->bounds.x / tile_size), 0), wd->ladderindex.col_count - 1);
+      wd->ladderindex.cols[c + 1]++;
+      wd->ladderindex.max_w = max(wd->ladderindex.max_w, (int)ceil(l->bounds.w / tile_size));
    }
-   return 0;
+   for (int c = 0; c < wd->ladderindex.col_count; c++) {
+      wd->ladderindex.cols[c + 1] += wd->ladderindex.cols[c];
+   }
+   int *cursor = (int*)malloc(wd->ladderindex.col_count * sizeof(int));
+   memcpy(cursor, wd->ladderindex.cols, wd->ladderindex.col_count * sizeof(int));
+   for (int i = 0; i < wd->ladders.count; i++) {
+      ladder *l = wd->ladders.at(i);
+      int c = min(max((int)floor(l->bounds.x / tile_size), 0), wd->ladderindex.col_count - 1);
+      wd->ladderindex.items[cursor[c]++] = i;
+   }
+   free(cursor);
 }
 
-int rectIntersectsLadders(rect *mr)
+// range of index columns whose ladders could reach x0..x1, edges included
+void getLadderColumns(world *wd, float x0, float x1, int *c0, int *c1)
 {
-   for (int i = 0; i < countof(ladder); i++) {
-      ladder *l = tc_at(ladder, i);
-      if (rectsOverlap(mr, &l->bounds)) {
-         return 1;
-      }
-   }
-   return 0;
+   *c0 = max((int)floor(x0 / tile_size) - wd->ladderindex.max_w, 0);
+   *c1 = min((int)floor(x1 / tile_size), wd->ladderindex.col_count - 1);
 }
 
-int pointOnLadders(v2 *p)
+// everything the player needs to know about ladders in one pass: the first
+// ladder touching bounds, and whether point (if given) is on any ladder
+void queryLadders(world *wd, rect *bounds, v2 *point, ladderfacts *out)
 {
-   for (int i = 0; i < countof(ladder); i++) {
-      ladder *l = tc_at(ladder, i);
-      if (pointInRect(p, &l->bounds)) {
-         return 1;
+   out->touching = 0;
+   out->onpoint = 0;
+   if (!wd->ladderindex.cols) {
+      return;
+   }
+   float x0 = bounds?bounds->x:point->x;
+   float x1 = bounds?(bounds->x + bounds->w):point->x;
+   if (point) {
+      x0 = fmin(x0, point->x);
+      x1 = fmax(x1, point->x);
+   }
+   int c0, c1;
+   getLadderColumns(wd, x0, x1, &c0, &c1);
+   int best = wd->ladders.count;
+   for (int c = c0; c <= c1; c++) {
+      for (int j = wd->ladderindex.cols[c]; j < wd->ladderindex.cols[c + 1]; j++) {
+         int i = wd->ladderindex.items[j];
+         ladder *l = wd->ladders.at(i);
+         if (bounds && i < best && rectsOverlap(bounds, &l->bounds)) {
+            best = i;
+         }
+         if (point && !out->onpoint && pointInRect(point, &l->bounds)) {
+            out->onpoint = 1;
+         }
       }
    }
-   return 0;
+   if (best < wd->ladders.count) {
+      out->touching = wd->ladders.at(best);
+   }
+}
+
+ladder* getIntersectingLadder(world *wd, rect *mr)
+{
+   ladderfacts facts;
+   queryLadders(wd, mr, 0, &facts);
+   return facts.touching;
+}
+
+int rectIntersectsLadders(world *wd, rect *mr)
+{
+   return getIntersectingLadder(wd, mr) != 0;
+}
+
+int pointOnLadders(world *wd, v2 *p)
+{
+   ladderfacts facts;
+   queryLadders(wd, 0, p, &facts);
+   return facts.onpoint;
 }
 
-void drawLadders()
+void drawLadders(world *wd)
 {
+   if (!wd->ladderindex.cols) {
+      return;
+   }
+   Uint64 prof_start = profBegin();
    SDL_Rect lrect;
    lrect.w = lrect.h = 16;
-   for (int i = 0; i < countof(ladder); i++) {
-      ladder *l = tc_at(ladder, i);
-      if (rectOnScreen(&l->bounds)) {
-         lrect.x = l->bounds.x - camera.position.x;
-         int max = l->bounds.y + l->bounds.h;
-         for (int y = l->bounds.y; y < max; y += 16) {
-            lrect.y = y - camera.position.y;
-            SDL_RenderCopy(ren, tex.ladder, 0, &lrect);
+   int c0, c1;
+   getLadderColumns(wd, wd->camera.view.x, wd->camera.view.x + field_w, &c0, &c1);
+   for (int c = c0; c <= c1; c++) {
+      for (int j = wd->ladderindex.cols[c]; j < wd->ladderindex.cols[c + 1]; j++) {
+         ladder *l = wd->ladders.at(wd->ladderindex.items[j]);
+         if (rectInView(wd, &l->bounds)) {
+            lrect.x = l->bounds.x - wd->camera.view.x;
+            int max = l->bounds.y + l->bounds.h;
+            for (int y = l->bounds.y; y < max; y += 16) {
+               lrect.y = y - wd->camera.view.y;
+               batchSprite(tex.ladder.tex, &tex.ladder.rect, &lrect, 0);
+            }
          }
       }
    }
+   profEnd(prof_ladders, prof_start);
 }
 
-struct wall {
-   rect bounds;
-   int active;
+int tileSolid(world *wd, int x, int y)
+{
+   if (x < 0 || y < 0 || x >= wd->tilemap.width || y >= wd->tilemap.height) {
+      return 0;
+   }
+   int ind = x + y * wd->tilemap.width;
+   return (wd->tilemap.solid[ind >> 3] >> (ind & 7)) & 1;
+}
+
+void setSolidRectangle(world *wd, int x, int y, int w, int h)
+{
+   int xs = max(x, 0);
+   int ys = max(y, 0);
+   int xm = min(wd->tilemap.width,  x + w);
+   int ym = min(wd->tilemap.height, y + h);
+   for (y = ys; y < ym; y++) {
+      for (x = xs; x < xm; x++) {
+         int ind = x + y * wd->tilemap.width;
+         wd->tilemap.solid[ind >> 3] |= 1 << (ind & 7);
+      }
+   }
+}
+
+enum phys_backends {
+   pb_walls,
+   pb_tiles,
+   pb_crosscheck
 };
+int phys_backend = pb_walls;
+
+void getWallGridSpan(world *wd, rect *r, int *x0, int *y0, int *x1, int *y1)
+{
+   *x0 = min(max((int)floor(r->x / WALLGRID_CELL), 0), wd->wallgrid.cell_w - 1);
+   *y0 = min(max((int)floor(r->y / WALLGRID_CELL), 0), wd->wallgrid.cell_h - 1);
+   *x1 = min(max((int)floor((r->x + r->w) / WALLGRID_CELL), 0), wd->wallgrid.cell_w - 1);
+   *y1 = min(max((int)floor((r->y + r->h) / WALLGRID_CELL), 0), wd->wallgrid.cell_h - 1);
+}
+
+void buildWallGrid(world *wd)
+{
+   free(wd->wallgrid.cells);
+   free(wd->wallgrid.items);
+   wd->wallgrid.cell_w = max((int)ceil(wd->room.bounds.w / WALLGRID_CELL), 1);
+   wd->wallgrid.cell_h = max((int)ceil(wd->room.bounds.h / WALLGRID_CELL), 1);
+   int cellcount = wd->wallgrid.cell_w * wd->wallgrid.cell_h;
+   wd->wallgrid.cells = (int*)calloc(cellcount + 1, sizeof(int));
+
+   int x0, y0, x1, y1;
+   for (int i = 0; i < wd->walls.count; i++) {
+      wall *w = wd->walls.at(i);
+      if (w->active) {
+         getWallGridSpan(wd, &w->bounds, &x0, &y0, &x1, &y1);
+         for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+               wd->wallgrid.cells[x + y * wd->wallgrid.cell_w + 1]++;
+            }
+         }
+      }
+   }
+   for (int c = 0; c < cellcount; c++) {
+      wd->wallgrid.cells[c + 1] += wd->wallgrid.cells[c];
+   }
+
+   wd->wallgrid.items = (int*)malloc(max(wd->wallgrid.cells[cellcount], 1) * sizeof(int));
+   int *cursor = (int*)malloc(cellcount * sizeof(int));
+   memcpy(cursor, wd->wallgrid.cells, cellcount * sizeof(int));
+   for (int i = 0; i < wd->walls.count; i++) {
+      wall *w = wd->walls.at(i);
+      if (w->active) {
+         getWallGridSpan(wd, &w->bounds, &x0, &y0, &x1, &y1);
+         for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+               wd->wallgrid.items[cursor[x + y * wd->wallgrid.cell_w]++] = i;
+            }
+         }
+      }
+   }
+   free(cursor);
+   wd->wallgrid.dirty = 0;
+}
+
+int wall_simd = 1;
+
+void syncWallSoa(world *wd, int i)
+{
+   wallsoa_s *ws = &wd->wallsoa;
+   if (ws->cap < wd->walls.capacity()) {
+      ws->cap = wd->walls.capacity();
+      ws->x = (float*)realloc(ws->x, ws->cap * sizeof(float));
+      ws->y = (float*)realloc(ws->y, ws->cap * sizeof(float));
+      ws->w = (float*)realloc(ws->w, ws->cap * sizeof(float));
+      ws->h = (float*)realloc(ws->h, ws->cap * sizeof(float));
+      ws->active = (int*)realloc(ws->active, ws->cap * sizeof(int));
+      ws->fixedbounds = (frect*)realloc(ws->fixedbounds, ws->cap * sizeof(frect));
+   }
+   wall *w = wd->walls.at(i);
+   wd->wallsoa.x[i] = w->bounds.x;
+   wd->wallsoa.y[i] = w->bounds.y;
+   wd->wallsoa.w[i] = w->bounds.w;
+   wd->wallsoa.h[i] = w->bounds.h;
+   wd->wallsoa.active[i] = w->active?-1:0;
+   wd->wallsoa.fixedbounds[i] = toFixedRect(&w->bounds);
+}
+
+void setWallActive(world *wd, wall *w, int active)
+{
+   if (w->active != active) {
+      w->active = active;
+      wd->wallgrid.dirty = 1;
+      syncWallSoa(wd, wd->walls.indexOf(w));
+   }
+}
+
+// fills wallquery.found with every wall in the given cells, each listed once
+int gatherWallCells(world *wd, int x0, int y0, int x1, int y1)
+{
+   int count = 0;
+   if (wallquery.cap < wd->walls.capacity()) {
+      int old = wallquery.cap;
+      wallquery.cap = wd->walls.capacity();
+      wallquery.stamp = (int*)realloc(wallquery.stamp, wallquery.cap * sizeof(int));
+      wallquery.found = (int*)realloc(wallquery.found, wallquery.cap * sizeof(int));
+      memset(wallquery.stamp + old, 0, (wallquery.cap - old) * sizeof(int));
+   }
+   wallquery.query++;
+   for (int y = y0; y <= y1; y++) {
+      for (int x = x0; x <= x1; x++) {
+         int c = x + y * wd->wallgrid.cell_w;
+         for (int j = wd->wallgrid.cells[c]; j < wd->wallgrid.cells[c + 1]; j++) {
+            int ind = wd->wallgrid.items[j];
+            if (wallquery.stamp[ind] != wallquery.query) {
+               wallquery.stamp[ind] = wallquery.query;
+               wallquery.found[count++] = ind;
+            }
+         }
+      }
+   }
+   return count;
+}
+
+int gatherWalls(world *wd, rect *r)
+{
+   if (wd->wallgrid.dirty) {
+      buildWallGrid(wd);
+   }
+   int x0, y0, x1, y1;
+   getWallGridSpan(wd, r, &x0, &y0, &x1, &y1);
+   return gatherWallCells(wd, x0, y0, x1, y1);
+}
 
-tc_create(wall, wall, 512);
+// shifts floor towards negative infinity, so no float math is needed to find the cells
+int gatherWallsFixed(world *wd, frect *r)
+{
+   if (wd->wallgrid.dirty) {
+      buildWallGrid(wd);
+   }
+   int x0 = min(max(r->x >> (16 + WALLGRID_SHIFT), 0), wd->wallgrid.cell_w - 1);
+   int y0 = min(max(r->y >> (16 + WALLGRID_SHIFT), 0), wd->wallgrid.cell_h - 1);
+   int x1 = min(max((r->x + r->w) >> (16 + WALLGRID_SHIFT), 0), wd->wallgrid.cell_w - 1);
+   int y1 = min(max((r->y + r->h) >> (16 + WALLGRID_SHIFT), 0), wd->wallgrid.cell_h - 1);
+   return gatherWallCells(wd, x0, y0, x1, y1);
+}
 
-int rectIntersectsWalls(rect *mr)
+int rectIntersectsWallGrid(world *wd, rect *mr)
 {
-   for (int i = 0; i < countof(wall); i++) {
-      wall *w = tc_at(wall, i);
+   int count = gatherWalls(wd, mr);
+   for (int i = 0; i < count; i++) {
+      wall *w = wd->walls.at(wallquery.found[i]);
       if (w->active && rectsOverlap(mr, &w->bounds)) {
          return 1;
       }
@@ -605,35 +2157,332 @@ int rectIntersectsWalls(rect *mr)
    return 0;
 }
 
-int rectAgainstWall(rect *mr)
+// tile cells are offset by half a pixel, the same as createTileAlignedWall()
+rect tileCellRect(int x, int y)
+{
+   return makeRect(x * tile_size + 0.5, y * tile_size + 0.5, tile_size, tile_size);
+}
+
+int rectIntersectsTiles(world *wd, rect *mr)
+{
+   int x0 = ceil((mr->x - 0.5 - tile_size) / tile_size);
+   int y0 = ceil((mr->y - 0.5 - tile_size) / tile_size);
+   int x1 = floor((mr->x + mr->w - 0.5) / tile_size);
+   int y1 = floor((mr->y + mr->h - 0.5) / tile_size);
+   for (int y = y0; y <= y1; y++) {
+      for (int x = x0; x <= x1; x++) {
+         if (tileSolid(wd, x, y)) {
+            return 1;
+         }
+      }
+   }
+   // walls that aren't part of the tilemap, like the boulder blocker, come
+   // out of the wall grid with the rest
+   int count = gatherWalls(wd, mr);
+   for (int i = 0; i < count; i++) {
+      wall *w = wd->walls.at(wallquery.found[i]);
+      if (w->active && !w->fromtiles && rectsOverlap(mr, &w->bounds)) {
+         return 1;
+      }
+   }
+   return 0;
+}
+
+int rectIntersectsWalls(world *wd, rect *mr)
+{
+   switch (phys_backend) {
+      case pb_tiles:
+         return rectIntersectsTiles(wd, mr);
+      case pb_crosscheck:
+         {
+            int res = rectIntersectsWallGrid(wd, mr);
+            if (res != rectIntersectsTiles(wd, mr)) {
+               wd->phys_mismatches++;
+               printf("frame %d: overlap mismatch at (%f, %f, %f, %f)\n", wd->frame, mr->x, mr->y, mr->w, mr->h);
+            }
+            return res;
+         }
+      default:
+         return rectIntersectsWallGrid(wd, mr);
+   }
+}
+
+int rectAgainstWall(world *wd, rect *mr)
 {
    rect b = expandRect(mr, -0.5);
    b.x -= 1;
    b.w += 2;
-   return rectIntersectsWalls(&b);
+   return rectIntersectsWalls(wd, &b);
 }
 
-int rectOnGround(rect *mr)
+int rectOnGround(world *wd, rect *mr)
 {
    rect b = expandRect(mr, -0.5);
    b.y += 1;
-   return rectIntersectsWalls(&b);
+   return rectIntersectsWalls(wd, &b);
+}
+
+#ifdef WALL_LANES
+#if WALL_LANES == 8
+typedef __m256 wvec;
+inline wvec wset(float f) { return _mm256_set1_ps(f); }
+inline wvec wadd(wvec a, wvec b) { return _mm256_add_ps(a, b); }
+inline wvec wsub(wvec a, wvec b) { return _mm256_sub_ps(a, b); }
+inline wvec wdiv(wvec a, wvec b) { return _mm256_div_ps(a, b); }
+inline wvec wmax(wvec a, wvec b) { return _mm256_max_ps(a, b); }
+inline wvec wand(wvec a, wvec b) { return _mm256_and_ps(a, b); }
+inline wvec wlt(wvec a, wvec b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline wvec wgt(wvec a, wvec b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+inline wvec wge(wvec a, wvec b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+inline wvec wle(wvec a, wvec b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+inline wvec wsel(wvec m, wvec a, wvec b) { return _mm256_blendv_ps(b, a, m); }
+inline void wstore(float *p, wvec a) { _mm256_storeu_ps(p, a); }
+inline int wmask(wvec m) { return _mm256_movemask_ps(m); }
+#else
+typedef __m128 wvec;
+inline wvec wset(float f) { return _mm_set1_ps(f); }
+inline wvec wadd(wvec a, wvec b) { return _mm_add_ps(a, b); }
+inline wvec wsub(wvec a, wvec b) { return _mm_sub_ps(a, b); }
+inline wvec wdiv(wvec a, wvec b) { return _mm_div_ps(a, b); }
+inline wvec wmax(wvec a, wvec b) { return _mm_max_ps(a, b); }
+inline wvec wand(wvec a, wvec b) { return _mm_and_ps(a, b); }
+inline wvec wlt(wvec a, wvec b) { return _mm_cmplt_ps(a, b); }
+inline wvec wgt(wvec a, wvec b) { return _mm_cmpgt_ps(a, b); }
+inline wvec wge(wvec a, wvec b) { return _mm_cmpge_ps(a, b); }
+inline wvec wle(wvec a, wvec b) { return _mm_cmple_ps(a, b); }
+inline wvec wsel(wvec m, wvec a, wvec b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+inline void wstore(float *p, wvec a) { _mm_storeu_ps(p, a); }
+inline int wmask(wvec m) { return _mm_movemask_ps(m); }
+#endif
+
+// clipMovingRects() against up to WALL_LANES walls from wallsoa at once.
+// the walls never move, so the velocity signs are the same in every lane
+// and only the minkowski rects differ. the arithmetic follows the scalar
+// version op for op so the results are bit identical.
+void clipMovingRectLanes(world *wd, rect *a, v2 *da, int *inds, int lanes, int *hit, float *out_t, float *out_nx, float *out_ny)
+{
+   wvec bx, by, bw, bh, ok;
+#if WALL_LANES == 8
+   int pad[WALL_LANES] = {};
+   for (int k = 0; k < lanes; k++) {
+      pad[k] = inds[k];
+   }
+   __m256i idx = _mm256_loadu_si256((__m256i*)pad);
+   __m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32(lanes), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+   bx = _mm256_i32gather_ps(wd->wallsoa.x, idx, 4);
+   by = _mm256_i32gather_ps(wd->wallsoa.y, idx, 4);
+   bw = _mm256_i32gather_ps(wd->wallsoa.w, idx, 4);
+   bh = _mm256_i32gather_ps(wd->wallsoa.h, idx, 4);
+   ok = _mm256_castsi256_ps(_mm256_and_si256(valid, _mm256_i32gather_epi32(wd->wallsoa.active, idx, 4)));
+#else
+   float sx[WALL_LANES] = {}, sy[WALL_LANES] = {}, sw[WALL_LANES] = {}, sh[WALL_LANES] = {};
+   int sa[WALL_LANES] = {};
+   for (int k = 0; k < lanes; k++) {
+      int i = inds[k];
+      sx[k] = wd->wallsoa.x[i];
+      sy[k] = wd->wallsoa.y[i];
+      sw[k] = wd->wallsoa.w[i];
+      sh[k] = wd->wallsoa.h[i];
+      sa[k] = wd->wallsoa.active[i];
+   }
+   bx = _mm_loadu_ps(sx);
+   by = _mm_loadu_ps(sy);
+   bw = _mm_loadu_ps(sw);
+   bh = _mm_loadu_ps(sh);
+   ok = _mm_castsi128_ps(_mm_loadu_si128((__m128i*)sa));
+#endif
+   wvec zero = wset(0);
+   wvec one = wset(1);
+   wvec mone = wset(-1);
+   wvec mx = wsub(wset(a->x), wadd(bx, bw));
+   wvec my = wsub(wset(a->y), wadd(by, bh));
+   wvec mw = wadd(wset(a->w), bw);
+   wvec mh = wadd(wset(a->h), bh);
+   wvec mfx = wadd(mx, mw);
+   wvec mfy = wadd(my, mh);
+   float velx = 0.f - da->x;
+   float vely = 0.f - da->y;
+   wvec tstart = zero;
+   wvec tend = one;
+   wvec nx = zero;
+   wvec ny = zero;
+
+   if (vely > 0) {
+      wvec v = wset(vely);
+      ok = wand(ok, wge(mfy, zero));
+      wvec ts = wdiv(my, v);
+      wvec te = wdiv(mfy, v);
+      wvec upd = wge(ts, tstart);
+      tstart = wsel(upd, ts, tstart);
+      ny = wsel(upd, one, ny);
+      tend = wsel(wlt(te, tend), te, tend);
+   } else if (vely < 0) {
+      wvec v = wset(vely);
+      ok = wand(ok, wle(my, zero));
+      wvec ts = wdiv(mfy, v);
+      wvec te = wdiv(my, v);
+      wvec upd = wge(ts, tstart);
+      tstart = wsel(upd, ts, tstart);
+      ny = wsel(upd, mone, ny);
+      tend = wsel(wlt(te, tend), te, tend);
+   } else {
+      ok = wand(ok, wand(wlt(my, zero), wgt(mfy, zero)));
+   }
+
+   if (velx > 0) {
+      wvec v = wset(velx);
+      ok = wand(ok, wge(mfx, zero));
+      wvec ts = wdiv(mx, v);
+      wvec te = wdiv(mfx, v);
+      wvec upd = wge(ts, tstart);
+      tstart = wsel(upd, ts, tstart);
+      nx = wsel(upd, one, nx);
+      ny = wsel(upd, zero, ny);
+      tend = wsel(wlt(te, tend), te, tend);
+   } else if (velx < 0) {
+      wvec v = wset(velx);
+      ok = wand(ok, wle(mx, zero));
+      wvec ts = wdiv(mfx, v);
+      wvec te = wdiv(mx, v);
+      wvec upd = wge(ts, tstart);
+      tstart = wsel(upd, ts, tstart);
+      nx = wsel(upd, mone, nx);
+      ny = wsel(upd, zero, ny);
+      tend = wsel(wlt(te, tend), te, tend);
+   } else {
+      ok = wand(ok, wand(wlt(mx, zero), wgt(mfx, zero)));
+   }
+
+   float eps = PHYS_EPSILON;
+   ok = wand(ok, wlt(tstart, wadd(tend, wset(eps))));
+   int mask = wmask(ok);
+   wstore(out_t, wmax(wsub(tstart, wset(eps)), zero));
+   wstore(out_nx, nx);
+   wstore(out_ny, ny);
+   for (int k = 0; k < WALL_LANES; k++) {
+      hit[k] = (mask >> k) & 1;
+   }
 }
+#endif
 
-int clipMovingRectWithWalls(rect *mr, v2 *mrv, v2 *n, float *t)
+int clipMovingRectWithWallGrid(world *wd, rect *mr, v2 *mrv, v2 *n, float *t)
 {
    int res = 0;
    v2 wallv = {};
    v2 bestn = {};
    float bestt = 1.f;
-   for (int i = 0; i < countof(wall); i++) {
-      wall *w = tc_at(wall, i);
+   int besti = -1;
+   // the slab test accepts hits a little past the swept hull, so pad the broadphase query
+   rect hull = extendRect(*mr, *mrv);
+   hull = expandRect(&hull, 1 + PHYS_EPSILON * (fabs(mrv->x) + fabs(mrv->y)));
+   int count = gatherWalls(wd, &hull);
+#ifdef WALL_LANES
+   if (wall_simd) {
+      int hit[WALL_LANES];
+      float lane_t[WALL_LANES];
+      float lane_nx[WALL_LANES];
+      float lane_ny[WALL_LANES];
+      for (int j = 0; j < count; j += WALL_LANES) {
+         int lanes = min(count - j, WALL_LANES);
+         clipMovingRectLanes(wd, mr, mrv, wallquery.found + j, lanes, hit, lane_t, lane_nx, lane_ny);
+         for (int k = 0; k < lanes; k++) {
+            int i = wallquery.found[j + k];
+            res |= hit[k];
+            if (hit[k] && (lane_t[k] < bestt || (lane_t[k] == bestt && i < besti))) {
+               bestt = lane_t[k];
+               bestn = makev2(lane_nx[k], lane_ny[k]);
+               besti = i;
+            }
+         }
+      }
+      *n = bestn;
+      *t = bestt;
+      return res;
+   }
+#endif
+   for (int j = 0; j < count; j++) {
+      int i = wallquery.found[j];
+      wall *w = wd->walls.at(i);
       if (w->active) {
          float testt;
          v2 testn;
-         if (i == 0) {
-            int debug = -1;
+         int clipped = clipMovingRects(mr, mrv, &w->bounds, &wallv, &testn, &testt);
+         res |= clipped;
+         // ties go to the lowest wall index, same as the old linear scan
+         if (clipped != 0 && (testt < bestt || (testt == bestt && i < besti))) {
+            bestt = testt;
+            bestn = testn;
+            besti = i;
+         }
+      }
+   }
+   *n = bestn;
+   *t = bestt;
+   return res;
+}
+
+// walks the tile columns (or rows) under the swept hull in the order the rect reaches them,
+// and stops once the next one can't be entered before the best hit so far
+int clipMovingRectWithTiles(world *wd, rect *mr, v2 *mrv, v2 *n, float *t)
+{
+   int res = 0;
+   v2 wallv = {};
+   v2 bestn = {};
+   float bestt = 1.f;
+   rect hull = extendRect(*mr, *mrv);
+   hull = expandRect(&hull, 1 + PHYS_EPSILON * (fabs(mrv->x) + fabs(mrv->y)));
+   int x0 = floor((hull.x - 0.5) / tile_size);
+   int y0 = floor((hull.y - 0.5) / tile_size);
+   int x1 = floor((hull.x + hull.w - 0.5) / tile_size);
+   int y1 = floor((hull.y + hull.h - 0.5) / tile_size);
+
+   int alongx = fabs(mrv->x) >= fabs(mrv->y);
+   float speed = alongx?mrv->x:mrv->y;
+   int lstart = alongx?x0:y0;
+   int lend = alongx?x1:y1;
+   int step = 1;
+   if (speed < 0) {
+      int swap = lstart;
+      lstart = lend;
+      lend = swap;
+      step = -1;
+   }
+   for (int l = lstart; l != lend + step; l += step) {
+      if (speed != 0.f) {
+         float entry;
+         if (speed > 0) {
+            entry = (l * tile_size + 0.5 - (alongx?(mr->x + mr->w):(mr->y + mr->h))) / speed;
+         } else {
+            entry = ((l + 1) * tile_size + 0.5 - (alongx?mr->x:mr->y)) / speed;
+         }
+         if (entry - PHYS_EPSILON > bestt) {
+            break;
+         }
+      }
+      int cstart = alongx?y0:x0;
+      int cend = alongx?y1:x1;
+      for (int c = cstart; c <= cend; c++) {
+         int x = alongx?l:c;
+         int y = alongx?c:l;
+         if (tileSolid(wd, x, y)) {
+            rect cell = tileCellRect(x, y);
+            float testt;
+            v2 testn;
+            int clipped = clipMovingRects(mr, mrv, &cell, &wallv, &testn, &testt);
+            res |= clipped;
+            if (clipped != 0 && testt < bestt) {
+               bestt = testt;
+               bestn = testn;
+            }
          }
+      }
+   }
+   int count = gatherWalls(wd, &hull);
+   for (int j = 0; j < count; j++) {
+      wall *w = wd->walls.at(wallquery.found[j]);
+      if (w->active && !w->fromtiles) {
+         float testt;
+         v2 testn;
          int clipped = clipMovingRects(mr, mrv, &w->bounds, &wallv, &testn, &testt);
          res |= clipped;
          if (clipped != 0 && testt < bestt) {
@@ -647,7 +2496,15 @@ int clipMovingRectWithWalls(rect *mr, v2 *mrv, v2 *n, float *t)
    return res;
 }
 
-void getMotionWalled(rect *r, v2 *v, v2 *out_velocity, v2 *out_displacement)
+int clipMovingRectWithWalls(world *wd, int backend, rect *mr, v2 *mrv, v2 *n, float *t)
+{
+   if (backend == pb_tiles) {
+      return clipMovingRectWithTiles(wd, mr, mrv, n, t);
+   }
+   return clipMovingRectWithWallGrid(wd, mr, mrv, n, t);
+}
+
+void moveWalled(world *wd, int backend, rect *r, v2 *v, v2 *out_velocity, v2 *out_displacement)
 {
    rect bounds = *r;
    v2 clip_normal;
@@ -656,7 +2513,7 @@ void getMotionWalled(rect *r, v2 *v, v2 *out_velocity, v2 *out_displacement)
    v2 frame_vel = *v;
    v2 frame_displacement = {};
    for (int i = 0; i < 2; i++) {
-      if (clipMovingRectWithWalls(&bounds, &frame_vel, &clip_normal, &clip_time)) {
+      if (clipMovingRectWithWalls(wd, backend, &bounds, &frame_vel, &clip_normal, &clip_time)) {
          v2 clip_velocity = frame_vel * clip_time;
          frame_displacement = frame_displacement + clip_velocity;
          frame_vel = frame_vel * (1.f - (clip_time));
@@ -684,108 +2541,323 @@ void getMotionWalled(rect *r, v2 *v, v2 *out_velocity, v2 *out_displacement)
    }
 }
 
-void clearWalls()
-{
-   countof(wall) = 0;
-   countof(ladder) = 0;
-}
-
-void createWall(float x, float y, float w, float h)
+// the crosscheck compares where each backend moves the rect to, not each
+// sweep: a long wall and the tile cells under it round the time of a hit a
+// little differently, and in a corner either side can be hit first
+void getMotionWalledFloat(world *wd, rect *r, v2 *v, v2 *out_velocity, v2 *out_displacement)
 {
-   wall *wn = tc_new(wall);
-   if (wn) {
-      //printf("new wall: %f, %f, %f, %f\n", x, y, w, h);
-      wn->bounds = makeRect(x, y, w, h);
-      wn->active = 1;
+   if (phys_backend != pb_crosscheck) {
+      moveWalled(wd, phys_backend, r, v, out_velocity, out_displacement);
+      return;
    }
-}
-
-void createTileAlignedWall(int x, int y, int w, int h)
-{
-   if (w > 0 && h > 0) {
-      createWall(x * tile_size + 0.5, y * tile_size + 0.5, w * tile_size, h * tile_size);
+   v2 vel, disp, tvel, tdisp;
+   moveWalled(wd, pb_walls, r, v, &vel, &disp);
+   moveWalled(wd, pb_tiles, r, v, &tvel, &tdisp);
+   if (fabs(disp.x - tdisp.x) > PHYS_EPSILON || fabs(disp.y - tdisp.y) > PHYS_EPSILON || vel.x != tvel.x || vel.y != tvel.y) {
+      wd->phys_mismatches++;
+      printf("frame %d: motion mismatch at (%f, %f) v (%f, %f): walls d (%f, %f) v (%f, %f), tiles d (%f, %f) v (%f, %f)\n",
+            wd->frame, r->x, r->y, v->x, v->y, disp.x, disp.y, vel.x, vel.y, tdisp.x, tdisp.y, tvel.x, tvel.y);
+   }
+   if (out_velocity) {
+      *out_velocity = vel;
+   }
+   if (out_displacement) {
+      *out_displacement = disp;
    }
 }
 
-void debugDrawWalls(SDL_Renderer *ren)
+// clipMovingRects() in 16.16, moving rect a against a still wall b
+int clipMovingRectsFixed(frect *a, fv2 *da, frect *b, fv2 *n, fixed *t)
 {
-   for (int i = 0; i < countof(wall); i++) {
-      wall *w = tc_at(wall, i);
-      if (w->active) {
-         drawRect(ren, &w->bounds);
+   *t = FX_ONE;
+   n->x = n->y = 0;
+   fixed tstart = 0;
+   fixed tend = FX_ONE;
+   fixed mx = a->x - (b->x + b->w);
+   fixed my = a->y - (b->y + b->h);
+   fixed mw = a->w + b->w;
+   fixed mh = a->h + b->h;
+   fv2 vel = {-da->x, -da->y};
+   fv2 normal = {};
+
+   if (vel.y > 0) {
+      if (my + mh < 0) return 0;
+      fixed teststart = fxdiv(my, vel.y);
+      fixed testend = fxdiv(my + mh, vel.y);
+      if (teststart >= tstart) {
+         tstart = teststart;
+         normal.y = 1;
+         normal.x = 0;
+      }
+      if (testend < tend) {
+         tend = testend;
+      }
+   } else if (vel.y < 0) {
+      if (my > 0) return 0;
+      fixed teststart = fxdiv(my + mh, vel.y);
+      fixed testend = fxdiv(my, vel.y);
+      if (teststart >= tstart) {
+         tstart = teststart;
+         normal.y = -1;
+         normal.x = 0;
+      }
+      if (testend < tend) {
+         tend = testend;
+      }
+   } else {
+      if (!(my < 0 && my + mh > 0)) {
+         return 0;
       }
    }
-}
 
-struct asprite {
-   SDL_Texture *tex;
-   int framecount;
-   int pitch;
-   int w, h;
-};
+   if (vel.x > 0) {
+      if (mx + mw < 0) return 0;
+      fixed teststart = fxdiv(mx, vel.x);
+      fixed testend = fxdiv(mx + mw, vel.x);
+      if (teststart >= tstart) {
+         tstart = teststart;
+         normal.x = 1;
+         normal.y = 0;
+      }
+      if (testend < tend) {
+         tend = testend;
+      }
+   } else if (vel.x < 0) {
+      if (mx > 0) return 0;
+      fixed teststart = fxdiv(mx + mw, vel.x);
+      fixed testend = fxdiv(mx, vel.x);
+      if (teststart >= tstart) {
+         tstart = teststart;
+         normal.x = -1;
+         normal.y = 0;
+      }
+      if (testend < tend) {
+         tend = testend;
+      }
+   } else {
+      if (!(mx < 0 && mx + mw > 0)) {
+         return 0;
+      }
+   }
 
-asprite createAsprite(SDL_Texture *tex, int frame_w, int frame_h)
-{
-   asprite res;
-   res.tex = tex;
-   res.w = frame_w;
-   res.h = frame_h;
-   int texw, texh;
-   SDL_QueryTexture(tex, 0, 0, &texw, &texh);
-   res.pitch = texw / frame_w;
-   res.framecount = res.pitch * (texh / frame_h);
-   return res;
+   if (tstart < tend + PHYS_EPSILON_FX) {
+      *t = max(tstart - PHYS_EPSILON_FX, 0);
+      *n = normal;
+      return 1;
+   }
+   return 0;
 }
 
-void drawAnimatingAsprite(asprite *sp, float x, float y, int frame_start, int frame_count, float *time, int flip)
+int clipMovingRectWithWallsFixed(world *wd, frect *mr, fv2 *mrv, fv2 *n, fixed *t)
 {
-   int barrier;
-   if (frame_start + frame_count > sp->framecount) {
-      barrier = sp->framecount;
-   } else  {
-      barrier = frame_start + frame_count;
-   }
-   if (frame_start + ceil(*time) > barrier) {
-      *time = 0;
-   }
-   if (*time < 0.f) {
-      *time = (barrier - frame_start) - 0.01;
+   int res = 0;
+   fv2 bestn = {};
+   fixed bestt = FX_ONE;
+   int besti = -1;
+   frect hull = *mr;
+   hull.w += fxabs(mrv->x);
+   hull.h += fxabs(mrv->y);
+   if (mrv->x < 0) {
+      hull.x += mrv->x;
    }
-   int frame = frame_start + floor(*time);
-   if (frame > barrier) {
-      frame = frame_start;
+   if (mrv->y < 0) {
+      hull.y += mrv->y;
    }
-   SDL_Rect src;
-   SDL_Rect dest;
-   src.x = (frame % sp->pitch) * sp->w;
-   src.y = (frame / sp->pitch) * sp->h;
-   dest.x = floor(x - camera.position.x);
-   dest.y = floor(y - camera.position.y);
-   src.w = dest.w = sp->w;
-   src.h = dest.h = sp->h;
-   SDL_Point ofs = {sp->w * 0.5, sp->h * 0.5};
-   if (flip) { 
-      flip = SDL_FLIP_HORIZONTAL;
+   fixed pad = FX_ONE + fxmul(PHYS_EPSILON_FX, fxabs(mrv->x) + fxabs(mrv->y));
+   hull.x -= pad;
+   hull.y -= pad;
+   hull.w += 2 * pad;
+   hull.h += 2 * pad;
+   int count = gatherWallsFixed(wd, &hull);
+   for (int j = 0; j < count; j++) {
+      int i = wallquery.found[j];
+      if (wd->wallsoa.active[i]) {
+         fixed testt;
+         fv2 testn;
+         int clipped = clipMovingRectsFixed(mr, mrv, wd->wallsoa.fixedbounds + i, &testn, &testt);
+         res |= clipped;
+         if (clipped != 0 && (testt < bestt || (testt == bestt && i < besti))) {
+            bestt = testt;
+            bestn = testn;
+            besti = i;
+         }
+      }
    }
-   SDL_RenderCopyEx(ren, sp->tex, &src, &dest, 0, &ofs, (SDL_RendererFlip)flip);
+   *n = bestn;
+   *t = bestt;
+   return res;
 }
 
-void drawAspriteFrame(asprite *sp, float x, float y, int frame, int flip)
+// getMotionWalled() with the sweep done in 16.16. the rect and velocity
+// come in as floats and the displacement goes back out as one, so a body
+// rounds to the 16.16 grid every call and wanders off from where the float
+// sweep would have put it. --physics-bench measures by how much
+void getMotionWalledFixed(world *wd, rect *r, v2 *v, v2 *out_velocity, v2 *out_displacement)
 {
-   frame = frame % sp->framecount;
+   frect bounds = toFixedRect(r);
+   fv2 clip_normal;
+   fixed clip_time;
+   v2 ovel = *v;
+   fv2 frame_vel = {toFixed(v->x), toFixed(v->y)};
+   fv2 frame_displacement = {};
+   for (int i = 0; i < 2; i++) {
+      if (clipMovingRectWithWallsFixed(wd, &bounds, &frame_vel, &clip_normal, &clip_time)) {
+         fv2 clip_velocity = {fxmul(frame_vel.x, clip_time), fxmul(frame_vel.y, clip_time)};
+         frame_displacement.x += clip_velocity.x;
+         frame_displacement.y += clip_velocity.y;
+         frame_vel.x = fxmul(frame_vel.x, FX_ONE - clip_time);
+         frame_vel.y = fxmul(frame_vel.y, FX_ONE - clip_time);
+         bounds.x += clip_velocity.x;
+         bounds.y += clip_velocity.y;
+         if (clip_normal.x) {
+            ovel.x = 0;
+            frame_vel.x = 0;
+         }
+         if (clip_normal.y) {
+            ovel.y = 0;
+            frame_vel.y = 0;
+         }
+      } else {
+         frame_displacement.x += frame_vel.x;
+         frame_displacement.y += frame_vel.y;
+         break;
+      }
+   }
+
+   if (out_velocity) {
+      *out_velocity = ovel;
+   }
+   if (out_displacement) {
+      *out_displacement = makev2(fromFixed(frame_displacement.x), fromFixed(frame_displacement.y));
+   }
+}
+
+// the fixed path only knows the wall grid, other backends stay in float
+void getMotionWalled(world *wd, rect *r, v2 *v, v2 *out_velocity, v2 *out_displacement)
+{
+#ifdef FIXED_PHYSICS
+   if (phys_backend == pb_walls) {
+      getMotionWalledFixed(wd, r, v, out_velocity, out_displacement);
+      return;
+   }
+#endif
+   getMotionWalledFloat(wd, r, v, out_velocity, out_displacement);
+}
+
+void clearWalls(world *wd)
+{
+   wd->walls.clear();
+   wd->ladders.clear();
+   wd->wallgrid.dirty = 1;
+}
+
+wall* createWall(world *wd, float x, float y, float w, float h)
+{
+   wall *wn = wd->walls.add();
+   if (wn) {
+      //printf("new wall: %f, %f, %f, %f\n", x, y, w, h);
+      wn->bounds = makeRect(x, y, w, h);
+      wn->active = 1;
+      wn->fromtiles = 0;
+      wd->wallgrid.dirty = 1;
+      syncWallSoa(wd, wd->walls.count - 1);
+   }
+   return wn;
+}
+
+void createTileAlignedWall(world *wd, int x, int y, int w, int h)
+{
+   if (w > 0 && h > 0) {
+      wall *wn = createWall(wd, x * tile_size + 0.5, y * tile_size + 0.5, w * tile_size, h * tile_size);
+      if (wn) {
+         wn->fromtiles = 1;
+      }
+      setSolidRectangle(wd, x, y, w, h);
+   }
+}
+
+void debugDrawWalls(world *wd, SDL_Renderer *ren)
+{
+   for (int i = 0; i < wd->walls.count; i++) {
+      wall *w = wd->walls.at(i);
+      if (w->active) {
+         drawRect(wd, ren, &w->bounds);
+      }
+   }
+}
+
+asprite createAsprite(atlasimage image, int frame_w, int frame_h)
+{
+   asprite res;
+   res.tex = image.tex;
+   res.x = image.rect.x;
+   res.y = image.rect.y;
+   res.w = frame_w;
+   res.h = frame_h;
+   if (!image.tex) {
+      res.pitch = res.framecount = 1;
+      return res;
+   }
+   res.pitch = image.rect.w / frame_w;
+   res.framecount = res.pitch * (image.rect.h / frame_h);
+   return res;
+}
+
+// keeps an animation clock inside the frames it plays
+void wrapAnimation(asprite *sp, int frame_start, int frame_count, float *time)
+{
+   int barrier;
+   if (frame_start + frame_count > sp->framecount) {
+      barrier = sp->framecount;
+   } else  {
+      barrier = frame_start + frame_count;
+   }
+   if (frame_start + ceil(*time) > barrier) {
+      *time = 0;
+   }
+   if (*time < 0.f) {
+      *time = (barrier - frame_start) - 0.01;
+   }
+}
+
+// animation clocks are advanced by the simulation, drawing only reads them
+void advanceAnimation(asprite *sp, int frame_start, int frame_count, float *time, double step)
+{
+   *time += step;
+   wrapAnimation(sp, frame_start, frame_count, time);
+}
+
+void drawAnimatingAsprite(world *wd, asprite *sp, float x, float y, int frame_start, int frame_count, float time, int flip)
+{
+   wrapAnimation(sp, frame_start, frame_count, &time);
+   int barrier = min(frame_start + frame_count, sp->framecount);
+   int frame = frame_start + floor(time);
+   if (frame > barrier) {
+      frame = frame_start;
+   }
    SDL_Rect src;
    SDL_Rect dest;
-   src.x = (frame % sp->pitch) * sp->w;
-   src.y = (frame / sp->pitch) * sp->h;
-   dest.x = floor(x - camera.position.x);
-   dest.y = floor(y - camera.position.y);
+   src.x = sp->x + (frame % sp->pitch) * sp->w;
+   src.y = sp->y + (frame / sp->pitch) * sp->h;
+   dest.x = floor(x - wd->camera.view.x);
+   dest.y = floor(y - wd->camera.view.y);
    src.w = dest.w = sp->w;
    src.h = dest.h = sp->h;
-   SDL_Point ofs = {sp->w * 0.5, sp->h * 0.5};
-   if (flip) { 
-      flip = SDL_FLIP_HORIZONTAL;
-   }
-   SDL_RenderCopyEx(ren, sp->tex, &src, &dest, 0, &ofs, (SDL_RendererFlip)flip);
+   batchSprite(sp->tex, &src, &dest, flip);
+}
+
+void drawAspriteFrame(world *wd, asprite *sp, float x, float y, int frame, int flip)
+{
+   frame = frame % sp->framecount;
+   SDL_Rect src;
+   SDL_Rect dest;
+   src.x = sp->x + (frame % sp->pitch) * sp->w;
+   src.y = sp->y + (frame / sp->pitch) * sp->h;
+   dest.x = floor(x - wd->camera.view.x);
+   dest.y = floor(y - wd->camera.view.y);
+   src.w = dest.w = sp->w;
+   src.h = dest.h = sp->h;
+   batchSprite(sp->tex, &src, &dest, flip);
 }
 
 struct testsprite {
@@ -840,12 +2912,12 @@ struct control {
    };
 };
 
-tc_create(control, control, 16);
+pool<control, 16> controls(16);
 
 void startControlFrame()
 {
-   for (int i = 0; i < countof(control); i++) {
-      control *c = tc_at(control, i);
+   for (int i = 0; i < controls.count; i++) {
+      control *c = controls.at(i);
       c->pressed = 0;
       c->released = 0;
       c->frames++;
@@ -855,8 +2927,8 @@ void startControlFrame()
 void fireControlEvent(SDL_Event *e)
 {
    assert(e);
-   for (int i = 0; i < countof(control); i++) {
-      control *c = tc_at(control, i);
+   for (int i = 0; i < controls.count; i++) {
+      control *c = controls.at(i);
       switch (c->type) {
          case ct_axis:
             if (e->type == SDL_JOYAXISMOTION) {
@@ -944,7 +3016,7 @@ void fireControlEvent(SDL_Event *e)
 
 control * bindKey(int keysym)
 {
-   control *nc = tc_new(control);
+   control *nc = controls.add();
    if (nc) {
       nc->type = ct_key;
       nc->key.keysym = keysym;
@@ -954,7 +3026,7 @@ control * bindKey(int keysym)
 
 control * bindAxis(int axis, int side)
 {
-   control *nc = tc_new(control);
+   control *nc = controls.add();
    if (nc) {
       nc->type = ct_axis;
       nc->axis.axis = axis;
@@ -965,7 +3037,7 @@ control * bindAxis(int axis, int side)
 
 control * bindButton(int button)
 {
-   control *nc = tc_new(control);
+   control *nc = controls.add();
    if (nc) {
       nc->type = ct_button;
       nc->button.button = button;
@@ -975,7 +3047,7 @@ control * bindButton(int button)
 
 void clearBindings()
 {
-   countof(control) = 0;
+   controls.clear();
 }
 
 struct {
@@ -988,22 +3060,9 @@ struct {
    control *reset;
 } con;
 
-struct effect {
-   asprite spr;
-   v2 offset;
-   v2 position;
-   v2 velocity;
-   int timer;
-   int timer_start;
-   int frame_start;
-   int frame_end;
-};
-
-tc_create(effect, effect, 32);
-
-void createEffect(SDL_Texture *t, v2 position, v2 velocity, int w, int h, int framestart, int frameend, int time)
+void createEffect(world *wd, atlasimage t, v2 position, v2 velocity, int w, int h, int framestart, int frameend, int time)
 {
-   effect *e = tc_new(effect);
+   effect *e = wd->effects.add();
    if (e) {
       e->spr = createAsprite(t, w, h);
       e->offset = makev2(-w/2, -h/2);
@@ -1015,69 +3074,68 @@ void createEffect(SDL_Texture *t, v2 position, v2 velocity, int w, int h, int fr
    }
 }
 
-void effect_smalldie(v2 position)
+void effect_smalldie(world *wd, v2 position)
 {
-   createEffect(tex.effect, position, makev2(0,0), 16, 16, 4, 6, 10);
+   createEffect(wd, tex.effect, position, makev2(0,0), 16, 16, 4, 6, 10);
 }
 
-void effect_explode(v2 position)
+void effect_explode(world *wd, v2 position)
 {
    float step = M_PI / 4;
    for (int i = 0; i < 8; i++) {
       v2 vel = makeRotatedV2(0, 1.3, step * i);
       v2 pos = position + makeRotatedV2(4, 0, step * i);
-      createEffect(tex.effect, pos, vel, 16, 16, 4, 6, 20);
+      createEffect(wd, tex.effect, pos, vel, 16, 16, 4, 6, 20);
    }
 }
 
-void effect_explode_large(v2 position)
+void effect_explode_large(world *wd, v2 position)
 {
    float step = M_PI / 4;
    for (int i = 0; i < 8; i++) {
       v2 vel = makeRotatedV2(0, 0.1, step * i);
       v2 pos = position + makeRotatedV2(4, 0, step * i);
-      createEffect(tex.effect, pos, vel, 16, 16, 12, 15, 100);
+      createEffect(wd, tex.effect, pos, vel, 16, 16, 12, 15, 100);
    }
    for (int j = 0; j < 3; j++) {
       for (int i = 0; i < 8; i++) {
          v2 vel = makeRotatedV2(0, 0.3 + 0.3 * j, step * i);
          v2 pos = position + makeRotatedV2(4, 0, step * i);
-         createEffect(tex.effect, pos, vel, 16, 16, 4, 6, 60 - 20 * j);
+         createEffect(wd, tex.effect, pos, vel, 16, 16, 4, 6, 60 - 20 * j);
       }
    }
 }
 
-void drawEffects()
+void tickEffects(world *wd)
 {
-   for (int i = 0; i < countof(effect); i++) {
-      effect *e = tc_at(effect, i);
+   for (int i = 0; i < wd->effects.count; i++) {
+      effect *e = wd->effects.at(i);
       if (e->timer == 0) {
-         tc_erase(effect, i);
+         wd->effects.erase(i);
          i--;
          continue;
       }
       e->timer -= 1;
-      float t = (float)(e->timer_start - e->timer)/e->timer_start;
-      int frame = floor(((float)e->frame_start + 0.5)*(1 - t) + ((float)e->frame_end + 0.5)*(t));
       e->position = e->position + e->velocity;
-      v2 drawpos = e->position + e->offset;
-      drawAspriteFrame(&e->spr, drawpos.x, drawpos.y, frame, 0);
    }
 }
 
-struct p_shot {
-   rect worldbounds;
-   asprite spr;
-   v2 position;
-   v2 velocity;
-   int last_bounds_frame;
-};
-
-tc_create(p_shot, pshot, 3);
+void drawEffects(world *wd)
+{
+   Uint64 prof_start = profBegin();
+   for (int i = 0; i < wd->effects.count; i++) {
+      effect *e = wd->effects.at(i);
+      float t = (float)(e->timer_start - e->timer)/e->timer_start;
+      int frame = floor(((float)e->frame_start + 0.5)*(1 - t) + ((float)e->frame_end + 0.5)*(t));
+      v2 drawpos = interp(wd, e->prev_position, e->position) + e->offset;
+      drawAspriteFrame(wd, &e->spr, drawpos.x, drawpos.y, frame, 0);
+   }
+   profEnd(prof_effects, prof_start);
+}
 
-rect* getPshotBounds(p_shot *p)
+rect* getPshotBounds(world *wd, p_shot *p)
 {
-   if (p->last_bounds_frame != frame) {
+   if (p->last_bounds_frame != wd->frame) {
       float width = 4;
       float height = 4;
       p->worldbounds.x = p->position.x - 0.5*width;
@@ -1088,9 +3146,9 @@ rect* getPshotBounds(p_shot *p)
    return &p->worldbounds;
 }
 
-void firePshot(float x, float y, float hspeed)
+void firePshot(world *wd, float x, float y, float hspeed)
 {
-   p_shot *shot = tc_new(pshot);
+   p_shot *shot = wd->pshots.add();
    if (shot) {
       play(sound.saber_shoot);
       shot->spr = createAsprite(tex.saber, 16, 16);
@@ -1098,69 +3156,54 @@ void firePshot(float x, float y, float hspeed)
       shot->position.y = y;
       shot->velocity.y = 0;
       shot->velocity.x = hspeed;
-      shot->last_bounds_frame = frame - 1;
+      shot->last_bounds_frame = wd->frame - 1;
    }
 }
 
-void stepPshots()
+void movePshots(world *wd)
 {
-   for (int i = 0; i < countof(pshot); i++) {
-      p_shot *shot = tc_at(pshot, i); 
+   for (int i = 0; i < wd->pshots.count; i++) {
+      p_shot *shot = wd->pshots.at(i); 
       shot->position = shot->velocity + shot->position;
    }
-   for (int i = 0; i < countof(pshot);) {
-      p_shot *shot = tc_at(pshot, i); 
-      if (shot->position.x < camera.position.x || shot->position.x > camera.position.x + field_w) {
-         tc_erase(pshot, i);
+}
+
+// thrown off the left of the room, so it's gone at the next cull
+void spendShot(p_shot *shot)
+{
+   shot->position.x = -1000;
+   shot->spent = 1;
+}
+
+void stepPshots(world *wd)
+{
+   Uint64 prof_start = profBegin();
+   movePshots(wd);
+   for (int i = 0; i < wd->pshots.count;) {
+      p_shot *shot = wd->pshots.at(i); 
+      if (shot->position.x < wd->camera.position.x || shot->position.x > wd->camera.position.x + field_w) {
+         wd->pshots.erase(i);
          continue;
       }
       i++;
    }
+   profEnd(prof_shots, prof_start);
 }
 
-void drawPshots()
+void drawPshots(world *wd)
 {
    float ofs_x = -8;
    float ofs_y = -8;
-   for (int i = 0; i < countof(pshot); i++) {
-      p_shot *shot = tc_at(pshot, i); 
-      shot->position = shot->velocity + shot->position;
-      drawAspriteFrame(&shot->spr, shot->position.x + ofs_x, shot->position.y + ofs_y, 3, (shot->velocity.x < 0.f));
-   }
-}
-
-p_shot* clipWithPshots(rect *r)
-{
-   for (int i = 0; i < countof(pshot); i++) {
-      p_shot *shot = tc_at(pshot, i); 
-      if (rectsOverlap(r, getPshotBounds(shot))) {
-         return shot;
-      }
+   for (int i = 0; i < wd->pshots.count; i++) {
+      p_shot *shot = wd->pshots.at(i); 
+      v2 pos = interp(wd, shot->prev_position, shot->position);
+      drawAspriteFrame(wd, &shot->spr, pos.x + ofs_x, pos.y + ofs_y, 3, (shot->velocity.x < 0.f));
    }
-   return 0;
 }
 
-struct player {
-   v2 position;
-   v2 velocity;
-   rect worldbounds;
-   float w, h;
-   float frame;
-   asprite spr;
-   int active;
-   int flip;
-   int alive;
-   int jumping;
-   int onladder;
-   int accept_ladder;
-   int last_bounds_frame;
-   int hitpoints;
-   int hurt_timer;
-} p1;
-
-rect * getPlayerBounds(player *p)
+rect * getPlayerBounds(world *wd, player *p)
 {
-   if (p->last_bounds_frame != frame) {
+   if (p->last_bounds_frame != wd->frame) {
       p->worldbounds.x = p->position.x - 0.5*p->w;
       p->worldbounds.y = p->position.y - 0.5*p->h;
       p->worldbounds.w = p->w;
@@ -1169,7 +3212,7 @@ rect * getPlayerBounds(player *p)
    return &p->worldbounds;
 }
 
-player createPlayer(float x, float y)
+player createPlayer(world *wd, float x, float y)
 {
    player res = {};
    //res.velocity.y = 100;
@@ -1178,35 +3221,36 @@ player createPlayer(float x, float y)
    res.w = 14;
    res.h = 14;
    res.active = res.alive = 1;
-   res.last_bounds_frame = frame-1;
+   res.last_bounds_frame = wd->frame-1;
    res.spr = createAsprite(tex.saber, 16, 16);
    res.hitpoints = 100;
    return res;
 }
 
-void hurtPlayer(float vx, float vy, int amount)
+void hurtPlayer(world *wd, float vx, float vy, int amount)
 {
-   if (p1.hurt_timer == 0) {
+   if (wd->p1.hurt_timer == 0) {
       play(sound.saber_hit);
-      p1.hitpoints = max(p1.hitpoints - amount, 0);
-      p1.velocity.x = vx;
-      p1.velocity.y = vy;
-      p1.hurt_timer = 200;
-      if (!rectIntersectsWalls(getPlayerBounds(&p1))) {
-         p1.onladder = 0;
+      wd->p1.hitpoints = max(wd->p1.hitpoints - amount, 0);
+      wd->p1.velocity.x = vx;
+      wd->p1.velocity.y = vy;
+      wd->p1.hurt_timer = 200;
+      if (!rectIntersectsWalls(wd, getPlayerBounds(wd, &wd->p1))) {
+         wd->p1.onladder = 0;
       }
    }
 }
 
-void healPlayer(int amount)
+void healPlayer(world *wd, int amount)
 {
    play(sound.saber_heal);
-   p1.hitpoints = min(p1.hitpoints + amount, 100);
+   wd->p1.hitpoints = min(wd->p1.hitpoints + amount, 100);
 }
 
 int player_hurt_threshold = 180;
-void tickPlayer(player *p)
+void tickPlayer(world *wd, player *p)
 {
+   Uint64 prof_start = profBegin();
    float player_accel = 0.4;
    float player_decel = 0.1;
    float player_wspeed = 1.5;
@@ -1220,37 +3264,41 @@ void tickPlayer(player *p)
          p->hurt_timer -= 1;
       }
       if (p->hurt_timer > player_hurt_threshold) {
-         if (rectOnGround(getPlayerBounds(p))) {
+         if (rectOnGround(wd, getPlayerBounds(wd, p))) {
             p->velocity.x = fapproach(p->velocity.x, 0, player_accel);
          }
          if (!p->onladder) {
             p->velocity.y += player_gravity;
             v2 frame_displacement;
-            getMotionWalled(getPlayerBounds(p), &p->velocity, &p->velocity, &frame_displacement);
+            getMotionWalled(wd, getPlayerBounds(wd, p), &p->velocity, &p->velocity, &frame_displacement);
             p->position = p->position + frame_displacement;
          }
       } else {
          if (p->hitpoints == 0) {
             p->alive = 0;
             play(sound.saber_die);
-            effect_explode_large(p->position);
+            effect_explode_large(wd, p->position);
             p->hurt_timer = 300;
          }
          if (con.fire->pressed) {
             if (con.left->held) {
-               firePshot(p->position.x, p->position.y, -player_shot_speed);
+               firePshot(wd, p->position.x, p->position.y, -player_shot_speed);
             } else if (con.right->held) {
-               firePshot(p->position.x, p->position.y, player_shot_speed);
+               firePshot(wd, p->position.x, p->position.y, player_shot_speed);
             } else {
                if (p->flip) {
-                  firePshot(p->position.x, p->position.y, -player_shot_speed);
+                  firePshot(wd, p->position.x, p->position.y, -player_shot_speed);
                } else {
-                  firePshot(p->position.x, p->position.y, player_shot_speed);
+                  firePshot(wd, p->position.x, p->position.y, player_shot_speed);
                }
             }
          }
+         // at most one ladder query a tick: the ladder being climbed before
+         // climbing it, or after walking whether the ladder point grabs one
+         ladderfacts facts;
          if (p->onladder) {
-            ladder *l = getIntersectingLadder(getPlayerBounds(p));
+            queryLadders(wd, getPlayerBounds(wd, p), 0, &facts);
+            ladder *l = facts.touching;
             if (l) {
                p->position.x = fapproach(p->position.x, l->bounds.x + l->bounds.w * 0.5, 1);
                if (con.up->held) {
@@ -1259,7 +3307,7 @@ void tickPlayer(player *p)
                   p->position.y = fapproach(p->position.y, l->bounds.y + l->bounds.h + 8, player_ladderspeed);
                }
                if (con.jump->pressed) {
-                  if (!rectIntersectsWalls(getPlayerBounds(p))) {
+                  if (!rectIntersectsWalls(wd, getPlayerBounds(wd, p))) {
                      p->onladder = 0;
                      p->velocity.x = 0;
                      p->velocity.y = -player_jump * 0.5;
@@ -1271,7 +3319,7 @@ void tickPlayer(player *p)
                p->velocity.y = 0;
             }
          } else {
-            rect bounds = *getPlayerBounds(p);
+            rect bounds = *getPlayerBounds(wd, p);
             if (con.left->held) {
                p->velocity.x = fapproach(p->velocity.x, -player_wspeed, player_accel);
                p->flip = 1;
@@ -1283,7 +3331,7 @@ void tickPlayer(player *p)
             }
 
             if (con.jump->held && con.jump->frames < player_jump_grace) {
-               if (rectOnGround(getPlayerBounds(p))) {
+               if (rectOnGround(wd, getPlayerBounds(wd, p))) {
                   p->velocity.y = -player_jump;
                   play(sound.saber_jump);
                   p->jumping = 1;
@@ -1299,7 +3347,7 @@ void tickPlayer(player *p)
             }
             p->velocity.y += player_gravity;
             v2 frame_displacement;
-            getMotionWalled(getPlayerBounds(p), &p->velocity, &p->velocity, &frame_displacement);
+            getMotionWalled(wd, getPlayerBounds(wd, p), &p->velocity, &p->velocity, &frame_displacement);
             p->position = p->position + frame_displacement;
             if (!p->accept_ladder) {
                p->accept_ladder = (con.up->pressed || con.down->pressed) || (con.up->held && con.jump->pressed);
@@ -1313,7 +3361,8 @@ void tickPlayer(player *p)
                if (con.down->held) {
                   ladderpoint.y += 8;
                }
-               if (pointOnLadders(&ladderpoint)) {
+               queryLadders(wd, 0, &ladderpoint, &facts);
+               if (facts.onpoint) {
                   p->accept_ladder = 0;
                   p->onladder = 1;
                }
@@ -1324,13 +3373,37 @@ void tickPlayer(player *p)
       if (p->hurt_timer > 0) {
          p->hurt_timer -= 1;
       } else {
-         loadLevel("startroom.txt", 0);
+         loadLevel(wd, "startroom.txt", 0);
+      }
+   }
+   setCameraFocus(wd, &p->position);
+   profEnd(prof_player, prof_start);
+}
+
+// the player only animates on the frames it's drawn on while blinking
+void animatePlayer(player *p)
+{
+   if (!p->alive) {
+      return;
+   }
+   if (p->hurt_timer > player_hurt_threshold) {
+      advanceAnimation(&p->spr, 1, 2, &p->frame, 0.6);
+   } else if (!((p->hurt_timer / 2)%2)) {
+      if (!p->onladder) {
+         if (fabs(p->velocity.y) <= 0.1 && fabs(p->velocity.x) > 0.1) {
+            advanceAnimation(&p->spr, 4, 4, &p->frame, 0.2);
+         }
+      } else {
+         if (con.up->held) {
+            advanceAnimation(&p->spr, 8, 4, &p->frame, 0.1);
+         } else if (con.down->held) {
+            advanceAnimation(&p->spr, 8, 4, &p->frame, -0.1);
+         }
       }
    }
-   setCameraFocus(&p->position);
 }
 
-void drawPlayer(player *p)
+void drawPlayer(world *wd, player *p)
 {
    if (!p->alive) {
       return;
@@ -1338,35 +3411,30 @@ void drawPlayer(player *p)
    SDL_SetRenderDrawColor(ren, 255, 255, 100, 255);
    float ofs_x = -8;
    float ofs_y = -9;
+   v2 pos = interp(wd, p->prev_position, p->position);
    if (p->hurt_timer > player_hurt_threshold) {
-      p->frame += 0.6;
-      drawAnimatingAsprite(&p->spr, p->position.x + ofs_x, p->position.y + ofs_y, 1, 2, &p->frame, p->flip);
+      drawAnimatingAsprite(wd, &p->spr, pos.x + ofs_x, pos.y + ofs_y, 1, 2, p->frame, p->flip);
    } else {
       if (!((p->hurt_timer / 2)%2)) {
          if (!p->onladder) {
             if (fabs(p->velocity.y) > 0.1) {
                if (p->velocity.y > 0) {
-                  drawAspriteFrame(&p->spr, p->position.x + ofs_x, p->position.y + ofs_y, 17, p->flip);
+                  drawAspriteFrame(wd, &p->spr, pos.x + ofs_x, pos.y + ofs_y, 17, p->flip);
                } else {
-                  drawAspriteFrame(&p->spr, p->position.x + ofs_x, p->position.y + ofs_y, 16, p->flip);
+                  drawAspriteFrame(wd, &p->spr, pos.x + ofs_x, pos.y + ofs_y, 16, p->flip);
                }
             } else {
                if (fabs(p->velocity.x) > 0.1) {
-                  p->frame += 0.2;
-                  drawAnimatingAsprite(&p->spr, p->position.x + ofs_x, p->position.y + ofs_y, 4, 4, &p->frame, p->flip);
+                  drawAnimatingAsprite(wd, &p->spr, pos.x + ofs_x, pos.y + ofs_y, 4, 4, p->frame, p->flip);
                } else {
-                  drawAspriteFrame(&p->spr, p->position.x + ofs_x, p->position.y + ofs_y, 0, p->flip);
+                  drawAspriteFrame(wd, &p->spr, pos.x + ofs_x, pos.y + ofs_y, 0, p->flip);
                }
             }
          } else {
-            if (con.up->held) {
-               p->frame += 0.1;
-               drawAnimatingAsprite(&p->spr, p->position.x + ofs_x, p->position.y + ofs_y, 8, 4, &p->frame, p->flip);
-            } else if (con.down->held) {
-               p->frame -= 0.1;
-               drawAnimatingAsprite(&p->spr, p->position.x + ofs_x, p->position.y + ofs_y, 8, 4, &p->frame, p->flip);
+            if (con.up->held || con.down->held) {
+               drawAnimatingAsprite(wd, &p->spr, pos.x + ofs_x, pos.y + ofs_y, 8, 4, p->frame, p->flip);
             } else {
-               drawAspriteFrame(&p->spr, p->position.x + ofs_x, p->position.y + ofs_y, 8, p->flip);
+               drawAspriteFrame(wd, &p->spr, pos.x + ofs_x, pos.y + ofs_y, 8, p->flip);
             }
          }
       }
@@ -1380,145 +3448,87 @@ void drawPlayer(player *p)
    healthrect.h = 100;
    healthbar.h = p->hitpoints;
    healthbar.y += healthrect.h - healthbar.h;
-   SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
-   SDL_RenderFillRect(ren, &healthrect);
-   SDL_SetRenderDrawColor(ren, 100, 255, 100, 255);
-   SDL_RenderFillRect(ren, &healthbar);
-   SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
-   SDL_RenderDrawRect(ren, &healthrect);
+   fillScreenRect(&healthrect, 0, 0, 0);
+   fillScreenRect(&healthbar, 100, 255, 100);
+   outlineScreenRect(&healthrect, 0, 0, 0);
 }
 
-struct boulderboss {
-   wall *blocker;
-   asprite spr;
-   int hitpoints;
-};
-
-tc_create(boulderboss, boulder, 1);
-
-rect* getBoulderBounds(boulderboss *bb)
+// 0 once the blocker wall is gone
+rect* getBoulderBounds(world *wd, boulderboss *bb)
 {
-   return (&bb->blocker->bounds);
+   wall *blocker = wd->walls.get(bb->blocker);
+   return blocker?&blocker->bounds:0;
 }
 
-void createBoulder(float x, float y)
+void createBoulder(world *wd, float x, float y)
 {
-   boulderboss *bb = tc_new(boulder);
+   boulderboss *bb = wd->boulders.add();
    if (bb) {
-      createWall(x, y + 32, 64, 32);
-      bb->blocker = tc_back(wall);
+      bb->blocker = wd->walls.handleAt(wd->walls.indexOf(createWall(wd, x, y + 32, 64, 32)));
       bb->hitpoints = 8;
+      bb->shot_hit = 0;
       bb->spr = createAsprite(tex.stone, 64, 64);
    }
 }
 
-struct dozermob {
-   asprite spr;
-   int hitpoints;
-   v2 position;
-   v2 velocity;
-   float frame;
-   int flip;
-   int flipping;
-   int state_timer;
-   int active;
-};
-
-tc_create(dozermob, dozer, 16);
+rect getDozerBounds(world *wd, int i)
+{
+   return makeRect(wd->dozers.position[i].x - 4, wd->dozers.position[i].y - 6, 8, 12);
+}
 
-void createDozer(float x, float y, int flip)
+void createDozer(world *wd, float x, float y, int flip)
 {
-   dozermob *dz = tc_new(dozer);
-   if (dz) {
-      dozermob blank = {};
-      *dz = blank;
-      dz->spr = createAsprite(tex.robots, 16, 16);
-      dz->position = makev2(x, y);
-      dz->velocity = makev2(0, 0);
-      dz->flip = flip; 
-      dz->hitpoints = 2;
-      dz->flipping = 0;
+   int i = wd->dozers.add();
+   if (i >= 0) {
+      wd->dozers.cold[i].spr = createAsprite(tex.robots, 16, 16);
+      wd->dozers.position[i] = makev2(x, y);
+      wd->dozers.hitpoints[i] = 2;
+      wd->dozers.flags[i] = flip?MOB_FLIP:0;
    }
 }
 
-struct bulletmob {
-   asprite spr;
-   int hitpoints;
-   v2 position;
-   float altitude;
-   float frame;
-   v2 velocity;
-   int flip;
-   int flipping;
-   int active;
-};
-
-tc_create(bulletmob, bullet, 16);
+rect getBulletMobBounds(world *wd, int i)
+{
+   return makeRect(wd->bullets.position[i].x - 4, wd->bullets.position[i].y - 4, 8, 8);
+}
 
-void createBulletMob(float x, float y, int flip)
+void createBulletMob(world *wd, float x, float y, int flip)
 {
-   bulletmob * b = tc_new(bullet);
-   if (b) {
-      bulletmob blank = {};
-      *b = blank;
-      b->spr = createAsprite(tex.robots, 16, 16);
-      b->hitpoints = 2;
-      b->position = makev2(x, y);
-      b->velocity = makev2(0, 0);
-      b->flip = flip;
-      b->altitude = y;
-      b->velocity.y = 0.6;
+   int i = wd->bullets.add();
+   if (i >= 0) {
+      wd->bullets.cold[i].spr = createAsprite(tex.robots, 16, 16);
+      wd->bullets.hitpoints[i] = 2;
+      wd->bullets.position[i] = makev2(x, y);
+      wd->bullets.velocity[i] = makev2(0, 0.6);
+      wd->bullets.flags[i] = flip?MOB_FLIP:0;
+      wd->bullets.altitude[i] = y;
    }
 };
 
-struct saucermob {
-   asprite spr;
-   v2 position;
-   v2 seek_vel;
-   int state_timer;
-   int active;
-   int hitpoints;
-   float frame;
-};
-
-tc_create(saucermob, saucer, 16);
+rect getSaucerBounds(world *wd, int i)
+{
+   return makeRect(wd->saucers.position[i].x - 6, wd->saucers.position[i].y - 4, 12, 8);
+}
 
-void createSaucerMob(float x, float y)
+void createSaucerMob(world *wd, float x, float y)
 {
-   saucermob *s = tc_new(saucer);
-   if (s) {
-      saucermob blank = {};
-      *s = blank;
-      s->spr = createAsprite(tex.robots, 16, 16);
-      s->position = makev2(x, y);
-      s->hitpoints = 4;
-      s->state_timer = rand() % 74;
+   int i = wd->saucers.add();
+   if (i >= 0) {
+      wd->saucers.cold[i].spr = createAsprite(tex.robots, 16, 16);
+      wd->saucers.position[i] = makev2(x, y);
+      wd->saucers.hitpoints[i] = 4;
+      wd->saucers.state_timer[i] = worldRand(wd) % 74;
    }
 }
 
-struct spidermob {
-   asprite spr;
-   v2 position;
-   int flip;
-   int shot_timer;
-   int active;
-   int hitpoints;
-   float frame;
-};
-
-tc_create(spidermob, spider, 16);
-
-struct slaser {
-   asprite spr;
-   v2 position;
-   float hspeed;
-};
-
-tc_create(slaser, slaser, 32);
+rect getSpiderBounds(world *wd, int i)
+{
+   return makeRect(wd->spiders.position[i].x - 6, wd->spiders.position[i].y - 6, 12, 12);
+}
 
-void fireSmallLaser(float x, float y, float hspeed)
+void fireSmallLaser(world *wd, float x, float y, float hspeed)
 {
-   slaser *sl = tc_new(slaser);
+   slaser *sl = wd->slasers.add();
    if (sl) {
       play(sound.spider_shoot);
       sl->spr = createAsprite(tex.robots, 16, 16);
@@ -1527,32 +3537,20 @@ void fireSmallLaser(float x, float y, float hspeed)
    }
 }
 
-void createSpiderMob(float x, float y, int flip)
+void createSpiderMob(world *wd, float x, float y, int flip)
 {
-   spidermob *sp = tc_new(spider);
-   if (sp) {
-      spidermob blank = {};
-      *sp = blank;
-      sp->spr = createAsprite(tex.robots, 16, 16);
-      sp->position = makev2(x, y);
-      sp->flip = flip;
-      sp->hitpoints = 3;
+   int i = wd->spiders.add();
+   if (i >= 0) {
+      wd->spiders.cold[i].spr = createAsprite(tex.robots, 16, 16);
+      wd->spiders.position[i] = makev2(x, y);
+      wd->spiders.flags[i] = flip?MOB_FLIP:0;
+      wd->spiders.hitpoints[i] = 3;
    }
 }
 
-struct item {
-   asprite spr;
-   v2 position;
-   int healamt;
-   int frame[2];
-   int timer;
-};
-
-tc_create(item, item, 8);
-
-void createItem(float x, float y, int islarge, int infinite)
+void createItem(world *wd, float x, float y, int islarge, int infinite)
 {
-   item *it = tc_new(item);
+   item *it = wd->items.add();
    if (it) {
       it->spr = createAsprite(tex.saber, 16, 16);
       it->position = makev2(x, y);
@@ -1573,30 +3571,21 @@ void createItem(float x, float y, int islarge, int infinite)
    }
 }
 
-void randomDrop(v2 position)
+void randomDrop(world *wd, v2 position)
 {
-   int dice = rand() % 64;
+   int dice = worldRand(wd) % 64;
    if (dice < 8) {
       if (dice%4) {
-         createItem(position.x, position.y, 0, 0);
+         createItem(wd, position.x, position.y, 0, 0);
       } else {
-         createItem(position.x, position.y, 1, 0);
+         createItem(wd, position.x, position.y, 1, 0);
       }
    }
 }
 
-struct mirvrocket {
-   asprite spr;
-   v2 position;
-   int direction;
-   v2 velocity;
-};
-
-tc_create(mirvrocket, mirvr, 512);
-
-void fireMirvRocket(float x, float y, float hs, float vs, int dir)
+void fireMirvRocket(world *wd, float x, float y, float hs, float vs, int dir)
 {
-   mirvrocket *mr = tc_new(mirvr);
+   mirvrocket *mr = wd->mirvrs.add();
    if (mr) {
       mr->spr = createAsprite(tex.effect, 16, 16);
       mr->position = makev2(x, y);
@@ -1605,313 +3594,762 @@ void fireMirvRocket(float x, float y, float hs, float vs, int dir)
    }
 }
 
-void tickEnemies()
+// work stealing scheduler behind parallelFor() and the frame's task graph.
+// every thread, the calling one included, has a deque of runnable tasks.
+// a thread pushes and pops at the back of its own, and when that's empty
+// it steals from the front of someone else's. whoever waits on tasks runs
+// tasks meanwhile, so a task can parallelFor() without tying up a thread.
+struct threadpool;
+struct taskgraph;
+
+struct task {
+   void (*fn)(void *data, int i);
+   void *data;
+   int i;
+   // counted down as tasks finish, whoever waits on it is woken at 0
+   SDL_atomic_t *remaining;
+   // set for graph tasks, finishing one releases the tasks after it
+   taskgraph *graph;
+   Uint64 start, end;
+   int worker;
+};
+
+struct taskdeque {
+   SDL_mutex *lock;
+   task **items;
+   int head, tail, cap;
+};
+
+struct poolworker {
+   threadpool *tp;
+   int index;
+};
+
+// a fixed set of worker threads. the calling thread works through tasks
+// too, as worker 0, so a pool of n threads has n - 1 workers
+struct threadpool {
+   SDL_Thread **threads;
+   poolworker *workers;
+   int thread_count;
+   taskdeque *deques;
+   SDL_mutex *lock;
+   SDL_cond *wake;
+   // tasks sitting in deques, idle threads sleep while it's 0
+   SDL_atomic_t queued;
+   int quit;
+};
+
+// which pool and deque the running thread belongs to
+thread_local poolworker worker_self;
+
+int selfWorker(threadpool *tp)
 {
-   for (int i = 0; i < countof(boulder); ) {
-      boulderboss *bb = tc_at(boulder, i);
-      p_shot *s = clipWithPshots(getBoulderBounds(bb));
-      if (s) {
-         s->position.x = -1000;
-         play(sound.hit);
-         bb->hitpoints--;
-         if (bb->hitpoints < 1) {
-            bb->blocker->active = 0;
-            v2 p = makev2(bb->blocker->bounds.x, bb->blocker->bounds.y) + makev2(32, 0);
-            effect_explode_large(p);
-            play(sound.rock_break);
-            randomDrop(p);
-            tc_erase(boulder, i);
-            continue;
-         }
-      }
-      i++;
-   }
-   for (int i = 0; i < countof(dozer); ) {
-      dozermob *dz = tc_at(dozer, i);
-      if (dz->hitpoints < 1) {
-         effect_smalldie(dz->position);
-         randomDrop(dz->position);
-         tc_erase(dozer, i);
-         continue;
+   return (worker_self.tp == tp)?worker_self.index:0;
+}
+
+void wakeWorkers(threadpool *tp)
+{
+   SDL_LockMutex(tp->lock);
+   SDL_CondBroadcast(tp->wake);
+   SDL_UnlockMutex(tp->lock);
+}
+
+// queues without waking anyone, call wakeWorkers() once the batch is in
+void pushTask(threadpool *tp, int self, task *t)
+{
+   taskdeque *dq = tp->deques + self;
+   SDL_LockMutex(dq->lock);
+   if (dq->tail == dq->cap) {
+      if (dq->head > 0) {
+         memmove(dq->items, dq->items + dq->head, (dq->tail - dq->head) * sizeof(task*));
+         dq->tail -= dq->head;
+         dq->head = 0;
+      } else {
+         dq->cap = max(dq->cap * 2, 64);
+         dq->items = (task**)realloc(dq->items, dq->cap * sizeof(task*));
       }
-      rect dozerbounds = makeRect(dz->position.x - 4, dz->position.y - 6, 8, 12);
-      dz->active = rectOnScreen(&dozerbounds);
-      if (dz->active) {
-         if (dz->flipping) {
-            dz->state_timer -= 1;
-            if (dz->state_timer < 1) {
-               dz->flipping = 0;
-               dz->flip = !dz->flip;
+   }
+   dq->items[dq->tail++] = t;
+   SDL_UnlockMutex(dq->lock);
+   SDL_AtomicAdd(&tp->queued, 1);
+}
+
+// newest task from our own deque, or else the oldest from someone else's
+task* findTask(threadpool *tp, int self)
+{
+   int deques = tp->thread_count + 1;
+   for (int k = 0; k < deques; k++) {
+      int v = (self + k) % deques;
+      taskdeque *dq = tp->deques + v;
+      task *t = 0;
+      SDL_LockMutex(dq->lock);
+      if (dq->head < dq->tail) {
+         t = (v == self)?dq->items[--dq->tail]:dq->items[dq->head++];
+         if (dq->head == dq->tail) {
+            dq->head = dq->tail = 0;
+         }
+      }
+      SDL_UnlockMutex(dq->lock);
+      if (t) {
+         SDL_AtomicAdd(&tp->queued, -1);
+         return t;
+      }
+   }
+   return 0;
+}
+
+void releaseTaskDependents(threadpool *tp, int self, task *t);
+
+void runTask(threadpool *tp, int self, task *t)
+{
+   t->worker = self;
+   t->start = SDL_GetPerformanceCounter();
+   t->fn(t->data, t->i);
+   t->end = SDL_GetPerformanceCounter();
+   if (t->graph) {
+      releaseTaskDependents(tp, self, t);
+   }
+   if (SDL_AtomicAdd(t->remaining, -1) == 1) {
+      wakeWorkers(tp);
+   }
+}
+
+// runs tasks, ours or stolen, until remaining gets to 0
+void helpUntilDone(threadpool *tp, SDL_atomic_t *remaining)
+{
+   int self = selfWorker(tp);
+   while (SDL_AtomicGet(remaining) > 0) {
+      task *t = findTask(tp, self);
+      if (t) {
+         runTask(tp, self, t);
+         continue;
+      }
+      SDL_LockMutex(tp->lock);
+      while (SDL_AtomicGet(remaining) > 0 && SDL_AtomicGet(&tp->queued) == 0) {
+         SDL_CondWait(tp->wake, tp->lock);
+      }
+      SDL_UnlockMutex(tp->lock);
+   }
+}
+
+int threadPoolWorker(void *data)
+{
+   poolworker *w = (poolworker*)data;
+   threadpool *tp = w->tp;
+   worker_self = *w;
+   for (;;) {
+      task *t = findTask(tp, w->index);
+      if (t) {
+         runTask(tp, w->index, t);
+         continue;
+      }
+      SDL_LockMutex(tp->lock);
+      while (!tp->quit && SDL_AtomicGet(&tp->queued) == 0) {
+         SDL_CondWait(tp->wake, tp->lock);
+      }
+      int quit = tp->quit;
+      SDL_UnlockMutex(tp->lock);
+      if (quit) {
+         break;
+      }
+   }
+   releaseWallQuery();
+   return 0;
+}
+
+threadpool* createThreadPool(int threads)
+{
+   threadpool *tp = (threadpool*)calloc(1, sizeof(threadpool));
+   tp->lock = SDL_CreateMutex();
+   tp->wake = SDL_CreateCond();
+   tp->thread_count = max(threads - 1, 0);
+   tp->deques = (taskdeque*)calloc(tp->thread_count + 1, sizeof(taskdeque));
+   for (int i = 0; i <= tp->thread_count; i++) {
+      tp->deques[i].lock = SDL_CreateMutex();
+   }
+   tp->workers = (poolworker*)calloc(tp->thread_count + 1, sizeof(poolworker));
+   tp->threads = (SDL_Thread**)calloc(tp->thread_count + 1, sizeof(SDL_Thread*));
+   for (int i = 0; i < tp->thread_count; i++) {
+      tp->workers[i].tp = tp;
+      tp->workers[i].index = i + 1;
+      tp->threads[i] = SDL_CreateThread(threadPoolWorker, "worker", tp->workers + i);
+   }
+   return tp;
+}
+
+void destroyThreadPool(threadpool *tp)
+{
+   SDL_LockMutex(tp->lock);
+   tp->quit = 1;
+   SDL_CondBroadcast(tp->wake);
+   SDL_UnlockMutex(tp->lock);
+   for (int i = 0; i < tp->thread_count; i++) {
+      SDL_WaitThread(tp->threads[i], 0);
+   }
+   for (int i = 0; i <= tp->thread_count; i++) {
+      SDL_DestroyMutex(tp->deques[i].lock);
+      free(tp->deques[i].items);
+   }
+   SDL_DestroyCond(tp->wake);
+   SDL_DestroyMutex(tp->lock);
+   free(tp->deques);
+   free(tp->workers);
+   free(tp->threads);
+   free(tp);
+}
+
+// calls fn(data, i) for i in [0, n) spread over the pool, returns once all
+// are done. safe to call from inside a task
+void parallelFor(threadpool *tp, int n, void (*fn)(void *data, int i), void *data)
+{
+   if (!tp || tp->thread_count == 0) {
+      for (int i = 0; i < n; i++) {
+         fn(data, i);
+      }
+      return;
+   }
+   SDL_atomic_t remaining;
+   SDL_AtomicSet(&remaining, n);
+   task *tasks = (task*)calloc(n, sizeof(task));
+   int self = selfWorker(tp);
+   // pushed backwards, so popping our own end hands them out from 0 up
+   for (int i = n - 1; i >= 0; i--) {
+      tasks[i].fn = fn;
+      tasks[i].data = data;
+      tasks[i].i = i;
+      tasks[i].remaining = &remaining;
+      pushTask(tp, self, tasks + i);
+   }
+   wakeWorkers(tp);
+   helpUntilDone(tp, &remaining);
+   free(tasks);
+}
+
+// a fixed set of named tasks and the order they have to run in, built
+// once and run every frame. tasks with nothing between them can overlap
+#define TASK_MAX 32
+#define TASK_DEPS_MAX 8
+
+struct taskgraph {
+   task tasks[TASK_MAX];
+   const char *names[TASK_MAX];
+   int deps[TASK_MAX][TASK_DEPS_MAX];
+   int dep_count[TASK_MAX];
+   // filled in from deps when the graph is run
+   int dependents[TASK_MAX][TASK_MAX];
+   int dependent_count[TASK_MAX];
+   SDL_atomic_t pending[TASK_MAX];
+   SDL_atomic_t remaining;
+   int count;
+   // per task timing summed over every run
+   Uint64 total[TASK_MAX];
+   Uint64 worst[TASK_MAX];
+   int runs;
+};
+
+// fn gets the task's id as i
+int addTask(taskgraph *g, const char *name, void (*fn)(void *data, int i), void *data)
+{
+   assert(g->count < TASK_MAX);
+   int id = g->count++;
+   memset(g->tasks + id, 0, sizeof(task));
+   g->tasks[id].fn = fn;
+   g->tasks[id].data = data;
+   g->tasks[id].i = id;
+   g->tasks[id].graph = g;
+   g->tasks[id].remaining = &g->remaining;
+   g->names[id] = name;
+   g->dep_count[id] = 0;
+   return id;
+}
+
+// t can't start until dep is done. deps always come from earlier tasks, so
+// the order tasks were added in is always a safe order to run them in
+void addTaskDep(taskgraph *g, int t, int dep)
+{
+   assert(dep < t && g->dep_count[t] < TASK_DEPS_MAX);
+   g->deps[t][g->dep_count[t]++] = dep;
+}
+
+void releaseTaskDependents(threadpool *tp, int self, task *t)
+{
+   taskgraph *g = t->graph;
+   int id = (int)(t - g->tasks);
+   int pushed = 0;
+   for (int k = 0; k < g->dependent_count[id]; k++) {
+      int d = g->dependents[id][k];
+      if (SDL_AtomicAdd(&g->pending[d], -1) == 1) {
+         pushTask(tp, self, g->tasks + d);
+         pushed = 1;
+      }
+   }
+   if (pushed) {
+      wakeWorkers(tp);
+   }
+}
+
+// with no pool, or a pool with no workers, the tasks run one after another
+// on the calling thread in the order they were added, for debugging
+void runTaskGraph(threadpool *tp, taskgraph *g)
+{
+   for (int i = 0; i < g->count; i++) {
+      g->dependent_count[i] = 0;
+   }
+   for (int i = 0; i < g->count; i++) {
+      SDL_AtomicSet(g->pending + i, g->dep_count[i]);
+      for (int k = 0; k < g->dep_count[i]; k++) {
+         int d = g->deps[i][k];
+         g->dependents[d][g->dependent_count[d]++] = i;
+      }
+   }
+   SDL_AtomicSet(&g->remaining, g->count);
+   if (!tp || tp->thread_count == 0) {
+      for (int i = 0; i < g->count; i++) {
+         task *t = g->tasks + i;
+         t->worker = 0;
+         t->start = SDL_GetPerformanceCounter();
+         t->fn(t->data, t->i);
+         t->end = SDL_GetPerformanceCounter();
+      }
+   } else {
+      int self = selfWorker(tp);
+      for (int i = g->count - 1; i >= 0; i--) {
+         if (g->dep_count[i] == 0) {
+            pushTask(tp, self, g->tasks + i);
+         }
+      }
+      wakeWorkers(tp);
+      helpUntilDone(tp, &g->remaining);
+   }
+   for (int i = 0; i < g->count; i++) {
+      Uint64 took = g->tasks[i].end - g->tasks[i].start;
+      g->total[i] += took;
+      if (took > g->worst[i]) {
+         g->worst[i] = took;
+      }
+   }
+   g->runs++;
+}
+
+void printTaskTimes(taskgraph *g)
+{
+   double freq = SDL_GetPerformanceFrequency();
+   printf("%-16s %10s %10s\n", "task", "mean us", "worst us");
+   for (int i = 0; i < g->count; i++) {
+      printf("%-16s %10.2f %10.2f\n", g->names[i], g->runs?g->total[i] * 1e6 / freq / g->runs:0.0, g->worst[i] * 1e6 / freq);
+   }
+}
+
+enemycmd* pushEnemyCmd(enemyjob *job, int type)
+{
+   cmdbuffer *cb = &job->cmds;
+   if (cb->count == cb->max) {
+      cb->max = max(cb->max * 2, 16);
+      cb->items = (enemycmd*)realloc(cb->items, cb->max * sizeof(enemycmd));
+   }
+   enemycmd *c = cb->items + cb->count++;
+   memset(c, 0, sizeof(enemycmd));
+   c->type = type;
+   return c;
+}
+
+void queueSound(enemyjob *job, Mix_Chunk *ch)
+{
+   pushEnemyCmd(job, ec_sound)->sound = ch;
+}
+
+// ec_smalldie, ec_explode or ec_drop at position
+void queueEffect(enemyjob *job, int type, v2 position)
+{
+   pushEnemyCmd(job, type)->position = position;
+}
+
+void queueLaser(enemyjob *job, v2 position, float hspeed)
+{
+   enemycmd *c = pushEnemyCmd(job, ec_laser);
+   c->position = position;
+   c->velocity.x = hspeed;
+}
+
+void queueSpendShot(enemyjob *job, int shot)
+{
+   pushEnemyCmd(job, ec_spend_shot)->amount = shot;
+}
+
+void queueHurtPlayer(enemyjob *job, float vx, float vy, int amount)
+{
+   enemycmd *c = pushEnemyCmd(job, ec_hurt_player);
+   c->velocity = makev2(vx, vy);
+   c->amount = amount;
+}
+
+void runEnemyCmds(world *wd, cmdbuffer *cb)
+{
+   for (int i = 0; i < cb->count; i++) {
+      enemycmd *c = cb->items + i;
+      switch (c->type) {
+         case ec_sound:
+            play(c->sound);
+            break;
+         case ec_smalldie:
+            effect_smalldie(wd, c->position);
+            break;
+         case ec_explode:
+            effect_explode(wd, c->position);
+            break;
+         case ec_drop:
+            randomDrop(wd, c->position);
+            break;
+         case ec_laser:
+            fireSmallLaser(wd, c->position.x, c->position.y, c->velocity.x);
+            break;
+         case ec_spend_shot:
+            {
+               p_shot *shot = wd->pshots.atSafe(c->amount);
+               if (shot) {
+                  spendShot(shot);
+               }
+            }break;
+         case ec_hurt_player:
+            hurtPlayer(wd, c->velocity.x, c->velocity.y, c->amount);
+            break;
+         default:
+            break;
+      }
+   }
+   cb->count = 0;
+}
+
+// the boulder switches its blocker wall off, which every other enemy sweeps
+// against, so it runs on its own before the jobs start
+void tickBoulders(world *wd)
+{
+   for (int i = 0; i < wd->boulders.count; ) {
+      boulderboss *bb = wd->boulders.at(i);
+      wall *blocker = wd->walls.get(bb->blocker);
+      if (!blocker) {
+         wd->boulders.erase(i);
+         continue;
+      }
+      p_shot *s = wd->pshots.atSafe(bb->shot_hit - 1);
+      if (s) {
+         spendShot(s);
+         play(sound.hit);
+         bb->hitpoints--;
+         if (bb->hitpoints < 1) {
+            setWallActive(wd, blocker, 0);
+            v2 p = makev2(blocker->bounds.x, blocker->bounds.y) + makev2(32, 0);
+            effect_explode_large(wd, p);
+            play(sound.rock_break);
+            randomDrop(wd, p);
+            wd->boulders.erase(i);
+            continue;
+         }
+      }
+      i++;
+   }
+}
+
+void tickDozers(world *wd, enemyjob *job)
+{
+   for (int i = job->start; i < job->end; i++) {
+      v2 *pos = wd->dozers.position + i;
+      v2 *vel = wd->dozers.velocity + i;
+      unsigned char *flags = wd->dozers.flags + i;
+      rect dozerbounds = getDozerBounds(wd, i);
+      *flags &= ~MOB_ACTIVE;
+      if (rectOnScreen(wd, &dozerbounds)) {
+         *flags |= MOB_ACTIVE;
+         if (*flags & MOB_FLIPPING) {
+            wd->dozers.state_timer[i] -= 1;
+            if (wd->dozers.state_timer[i] < 1) {
+               *flags &= ~MOB_FLIPPING;
+               *flags ^= MOB_FLIP;
             }
-            dz->velocity.x = fapproach(dz->velocity.x, 0, 0.1);
+            vel->x = fapproach(vel->x, 0, 0.1);
             v2 displacement;
-            getMotionWalled(&dozerbounds, &dz->velocity, &dz->velocity, &displacement);
-            dz->position = dz->position + displacement;
+            getMotionWalled(wd, &dozerbounds, vel, vel, &displacement);
+            *pos = *pos + displacement;
          } else {
             rect edgesensor;
-            if (dz->flip) {
-               dz->velocity.x = fapproach(dz->velocity.x, -1, 0.1);
-               edgesensor = makeRect(dz->position.x - 2 - 16, dz->position.y, 4, 9);
+            if (*flags & MOB_FLIP) {
+               vel->x = fapproach(vel->x, -1, 0.1);
+               edgesensor = makeRect(pos->x - 2 - 16, pos->y, 4, 9);
             } else {
-               dz->velocity.x = fapproach(dz->velocity.x, 1, 0.1);
-               edgesensor = makeRect(dz->position.x - 2 + 16, dz->position.y, 4, 9);
+               vel->x = fapproach(vel->x, 1, 0.1);
+               edgesensor = makeRect(pos->x - 2 + 16, pos->y, 4, 9);
             }
             v2 displacement;
-            getMotionWalled(&dozerbounds, &dz->velocity, &dz->velocity, &displacement);
-            dz->position = dz->position + displacement;
-            if (fabs(displacement.x) <= PHYS_EPSILON || !rectIntersectsWalls(&edgesensor)) {
-               dz->state_timer = 50;
-               dz->flipping = 1;
+            getMotionWalled(wd, &dozerbounds, vel, vel, &displacement);
+            *pos = *pos + displacement;
+            if (fabs(displacement.x) <= PHYS_EPSILON || !rectIntersectsWalls(wd, &edgesensor)) {
+               wd->dozers.state_timer[i] = 50;
+               *flags |= MOB_FLIPPING;
             }
          }
-         p_shot *bullet = clipWithPshots(&dozerbounds);
+         int shot = wd->dozers.shot_hit[i] - 1;
+         p_shot *bullet = wd->pshots.atSafe(shot);
          if (bullet) {
-            bullet->position.x = -1000;
-            if (dz->flip) {
+            queueSpendShot(job, shot);
+            if (*flags & MOB_FLIP) {
                if (bullet->velocity.x < 0) {
-                  dz->hitpoints -= 1;
-                  play(sound.hit);
+                  wd->dozers.hitpoints[i] -= 1;
+                  queueSound(job, sound.hit);
                } else {
-                  play(sound.reflect);
+                  queueSound(job, sound.reflect);
                }
             } else {
                if (bullet->velocity.x > 0) {
-                  dz->hitpoints -= 1;
-                  play(sound.hit);
+                  wd->dozers.hitpoints[i] -= 1;
+                  queueSound(job, sound.hit);
                } else {
-                  play(sound.reflect);
+                  queueSound(job, sound.reflect);
                }
             }
          }
-         if (rectsOverlap(&dozerbounds, getPlayerBounds(&p1))) {
-            if (p1.position.x > dz->position.x) {
-               if (dz->flip) {
-                  hurtPlayer(1, -1, 10);
+         if (rectsOverlap(&dozerbounds, &job->playerbounds)) {
+            if (wd->p1.position.x > pos->x) {
+               if (*flags & MOB_FLIP) {
+                  queueHurtPlayer(job, 1, -1, 10);
                } else {
-                  hurtPlayer(2, -1, 10);
+                  queueHurtPlayer(job, 2, -1, 10);
                }
             } else {
-               if (!dz->flip) {
-                  hurtPlayer(-1, -1, 10);
+               if (!(*flags & MOB_FLIP)) {
+                  queueHurtPlayer(job, -1, -1, 10);
                } else {
-                  hurtPlayer(-2, -1, 10);
+                  queueHurtPlayer(job, -2, -1, 10);
                }
             }
          }
       }
-      i++;
    }
-   for (int i = 0; i < countof(bullet); ) {
-      bulletmob *b = tc_at(bullet, i);
-      if (b->hitpoints < 1) {
-         effect_smalldie(b->position);
-         randomDrop(b->position);
-         tc_erase(bullet, i);
-         continue;
-      }
-      rect bulletbounds = makeRect(b->position.x - 4, b->position.y - 4, 8, 8);
-      b->active = rectOnScreen(&bulletbounds);
-      if (b->active) {
-         if (b->flipping) {
-            b->velocity.x = fapproach(b->velocity.x, 0, 0.04);
-            if (b->velocity.x == 0.f) {
-               b->flipping = 0;
-               b->flip = !b->flip;
+}
+
+void tickBulletMobs(world *wd, enemyjob *job)
+{
+   for (int i = job->start; i < job->end; i++) {
+      v2 *pos = wd->bullets.position + i;
+      v2 *vel = wd->bullets.velocity + i;
+      unsigned char *flags = wd->bullets.flags + i;
+      rect bulletbounds = getBulletMobBounds(wd, i);
+      *flags &= ~MOB_ACTIVE;
+      if (rectOnScreen(wd, &bulletbounds)) {
+         *flags |= MOB_ACTIVE;
+         if (*flags & MOB_FLIPPING) {
+            vel->x = fapproach(vel->x, 0, 0.04);
+            if (vel->x == 0.f) {
+               *flags &= ~MOB_FLIPPING;
+               *flags ^= MOB_FLIP;
             }
          } else {
             rect bulletsensor = bulletbounds;
-            if (b->flip) {
-               b->velocity.x = fapproach(b->velocity.x, -2, 0.01);
+            if (*flags & MOB_FLIP) {
+               vel->x = fapproach(vel->x, -2, 0.01);
                bulletsensor.x -= 64;
             } else {
-               b->velocity.x = fapproach(b->velocity.x, 2, 0.01);
+               vel->x = fapproach(vel->x, 2, 0.01);
                bulletsensor.x += 64;
             }
-            if (rectIntersectsWalls(&bulletsensor)) {
-               b->flipping = 1;
+            if (rectIntersectsWalls(wd, &bulletsensor)) {
+               *flags |= MOB_FLIPPING;
             }
          }
-         if (b->position.y < b->altitude) {
-            b->velocity.y += 0.01;
+         if (pos->y < wd->bullets.altitude[i]) {
+            vel->y += 0.01;
          } else {
-            b->velocity.y -= 0.01;
+            vel->y -= 0.01;
          }
          v2 displacement;
-         getMotionWalled(&bulletbounds, &b->velocity, &b->velocity, &displacement);
-         b->position = b->position + displacement;
-         p_shot *bullet = clipWithPshots(&bulletbounds);
-         if (bullet) {
-            bullet->position.x = -1000;
-            play(sound.hit);
-            b->hitpoints -= 1;
+         getMotionWalled(wd, &bulletbounds, vel, vel, &displacement);
+         *pos = *pos + displacement;
+         int shot = wd->bullets.shot_hit[i] - 1;
+         if (wd->pshots.atSafe(shot)) {
+            queueSpendShot(job, shot);
+            queueSound(job, sound.hit);
+            wd->bullets.hitpoints[i] -= 1;
          }
-         if (rectsOverlap(&bulletbounds, getPlayerBounds(&p1))) {
-            if (p1.position.x > b->position.x) {
-               if (b->flip) {
-                  hurtPlayer(1, -1, 10);
+         if (rectsOverlap(&bulletbounds, &job->playerbounds)) {
+            if (wd->p1.position.x > pos->x) {
+               if (*flags & MOB_FLIP) {
+                  queueHurtPlayer(job, 1, -1, 10);
                } else {
-                  hurtPlayer(2, -1, 10);
+                  queueHurtPlayer(job, 2, -1, 10);
                }
             } else {
-               if (!b->flip) {
-                  hurtPlayer(-1, -1, 10);
+               if (!(*flags & MOB_FLIP)) {
+                  queueHurtPlayer(job, -1, -1, 10);
                } else {
-                  hurtPlayer(-2, -1, 10);
+                  queueHurtPlayer(job, -2, -1, 10);
                }
             }
          }
       }
-      i++;
    }
-   for (int i = 0; i < countof(saucer); ) {
-      saucermob *s = tc_at(saucer, i);
-      if (s->hitpoints < 1) {
-         effect_smalldie(s->position);
-         randomDrop(s->position);
-         tc_erase(saucer, i);
-         continue;
-      }
-      rect saucerbounds = makeRect(s->position.x - 6, s->position.y - 4, 12, 8);
-      s->active = rectOnScreen(&saucerbounds);
-      if (s->active) {
-         s->state_timer += 1;
-         if (s->state_timer < 75) {
-            s->seek_vel = p1.position - s->position;
-            s->seek_vel = normalizev2(&s->seek_vel);
-         } else if (s->state_timer < 150) {
-            s->position = s->position + s->seek_vel;
+}
+
+void tickSaucers(world *wd, enemyjob *job)
+{
+   for (int i = job->start; i < job->end; i++) {
+      v2 *pos = wd->saucers.position + i;
+      rect saucerbounds = getSaucerBounds(wd, i);
+      wd->saucers.flags[i] &= ~MOB_ACTIVE;
+      if (rectOnScreen(wd, &saucerbounds)) {
+         wd->saucers.flags[i] |= MOB_ACTIVE;
+         int *timer = wd->saucers.state_timer + i;
+         v2 *seek = wd->saucers.seek_vel + i;
+         *timer += 1;
+         if (*timer < 75) {
+            *seek = wd->p1.position - *pos;
+            *seek = normalizev2(seek);
+         } else if (*timer < 150) {
+            *pos = *pos + *seek;
          } else {
-            s->state_timer = 0;
+            *timer = 0;
          }
-         p_shot *bullet = clipWithPshots(&saucerbounds);
-         if (bullet) {
-            bullet->position.x = -1000;
-            play(sound.hit);
-            s->hitpoints -= 1;
+         int shot = wd->saucers.shot_hit[i] - 1;
+         if (wd->pshots.atSafe(shot)) {
+            queueSpendShot(job, shot);
+            queueSound(job, sound.hit);
+            wd->saucers.hitpoints[i] -= 1;
          }
-         if (rectsOverlap(&saucerbounds, getPlayerBounds(&p1))) {
-            if (p1.position.x > s->position.x) {
-               hurtPlayer(1, -1, 10);
+         if (rectsOverlap(&saucerbounds, &job->playerbounds)) {
+            if (wd->p1.position.x > pos->x) {
+               queueHurtPlayer(job, 1, -1, 10);
             } else {
-               hurtPlayer(-1, -1, 10);
+               queueHurtPlayer(job, -1, -1, 10);
             }
          }
       }
-      i++;
    }
-   for (int i = 0; i < countof(slaser); ) {
-      slaser *sl = tc_at(slaser, i);
+}
+
+// lasers and rockets erase as they go, so each set is one job over the whole pool
+void tickSmallLasers(world *wd, enemyjob *job)
+{
+   for (int i = 0; i < wd->slasers.count; ) {
+      slaser *sl = wd->slasers.at(i);
       rect laserbounds = makeRect(sl->position.x - 6, sl->position.y - 2, 12, 4);
-      if (rectsOverlap(&laserbounds, getPlayerBounds(&p1))) {
-         hurtPlayer(sl->hspeed, -1, 20);
-         play(sound.spider_hit);
-         effect_explode(sl->position);
-         tc_erase(slaser, i);
+      if (rectsOverlap(&laserbounds, &job->playerbounds)) {
+         queueHurtPlayer(job, sl->hspeed, -1, 20);
+         queueSound(job, sound.spider_hit);
+         queueEffect(job, ec_explode, sl->position);
+         wd->slasers.erase(i);
          continue;
       }
       sl->position.x += sl->hspeed;
-      if (!rectInRoom(&laserbounds)) {
-         tc_erase(slaser, i);
+      if (!rectInRoom(wd, &laserbounds)) {
+         wd->slasers.erase(i);
          continue;
       }
       i++;
    }
-   for (int i = 0; i < countof(mirvr); ) {
-      mirvrocket *mr = tc_at(mirvr, i);
+}
+
+void tickMirvRockets(world *wd, enemyjob *job)
+{
+   for (int i = 0; i < wd->mirvrs.count; ) {
+      mirvrocket *mr = wd->mirvrs.at(i);
       rect rocketbounds = makeRect(mr->position.x - 4, mr->position.y - 4, 8, 8);
-      if (rectsOverlap(&rocketbounds, getPlayerBounds(&p1))) {
-         hurtPlayer(mr->velocity.x, -2, 20);
-         effect_explode(mr->position);
-         tc_erase(mirvr, i);
+      if (rectsOverlap(&rocketbounds, &job->playerbounds)) {
+         queueHurtPlayer(job, mr->velocity.x, -2, 20);
+         queueEffect(job, ec_explode, mr->position);
+         wd->mirvrs.erase(i);
          continue;
       }
       mr->position = mr->position + mr->velocity;
       if (mr->position.y > 0) {
-         if (!rectInRoom(&rocketbounds)) {
-            tc_erase(mirvr, i);
+         if (!rectInRoom(wd, &rocketbounds)) {
+            wd->mirvrs.erase(i);
             continue;
          }
       } else {
-         if (mr->position.x < 0 || mr->position.x > room.bounds.w) {
-            tc_erase(mirvr, i);
+         if (mr->position.x < 0 || mr->position.x > wd->room.bounds.w) {
+            wd->mirvrs.erase(i);
             continue;
          }
       }
       i++;
    }
-   for (int i = 0; i < countof(spider); ) {
-      spidermob *sp = tc_at(spider, i);
-      if (sp->hitpoints < 1) {
-         effect_smalldie(sp->position);
-         randomDrop(sp->position);
-         tc_erase(spider, i);
-         continue;
-      }
-      rect spiderbounds = makeRect(sp->position.x - 6, sp->position.y - 6, 12, 12);
-      sp->active = rectOnScreen(&spiderbounds);
-      if (sp->active) {
+}
+
+void tickSpiders(world *wd, enemyjob *job)
+{
+   for (int i = job->start; i < job->end; i++) {
+      v2 *pos = wd->spiders.position + i;
+      unsigned char *flags = wd->spiders.flags + i;
+      rect spiderbounds = getSpiderBounds(wd, i);
+      *flags &= ~MOB_ACTIVE;
+      if (rectOnScreen(wd, &spiderbounds)) {
+         *flags |= MOB_ACTIVE;
          int range = 100;
-         if (sp->shot_timer > 0) {
-            sp->shot_timer -= 1;
+         int *shot_timer = wd->spiders.shot_timer + i;
+         if (*shot_timer > 0) {
+            *shot_timer -= 1;
          } else {
             rect edgesensor;
-            rect playersensor = makeRect(sp->position.x, sp->position.y, range, 4);
+            rect playersensor = makeRect(pos->x, pos->y, range, 4);
             v2 fakevelocity;
             fakevelocity.y = 0;
-            if (sp->flip) {
-               edgesensor = makeRect(sp->position.x - 2 - 16, sp->position.y, 4, 12);
+            if (*flags & MOB_FLIP) {
+               edgesensor = makeRect(pos->x - 2 - 16, pos->y, 4, 12);
                playersensor.x -= range;
                fakevelocity.x = -0.15;
             } else {
-               edgesensor = makeRect(sp->position.x - 2 + 16, sp->position.y, 4, 12);
+               edgesensor = makeRect(pos->x - 2 + 16, pos->y, 4, 12);
                fakevelocity.x = 0.15;
             }
             v2 displacement;
-            getMotionWalled(&spiderbounds, &fakevelocity, 0, &displacement);
-            sp->position = sp->position + displacement;
-            if (rectsOverlap(&playersensor, getPlayerBounds(&p1))) {
-               sp->shot_timer = 50;
-               if (sp->flip) {
-                  fireSmallLaser(sp->position.x, sp->position.y, -4);
+            getMotionWalled(wd, &spiderbounds, &fakevelocity, 0, &displacement);
+            *pos = *pos + displacement;
+            if (rectsOverlap(&playersensor, &job->playerbounds)) {
+               *shot_timer = 50;
+               if (*flags & MOB_FLIP) {
+                  queueLaser(job, *pos, -4);
                } else {
-                  fireSmallLaser(sp->position.x, sp->position.y,  4);
+                  queueLaser(job, *pos,  4);
                }
             } else {
-               if (fabs(displacement.x) <= PHYS_EPSILON || !rectIntersectsWalls(&edgesensor)) {
-                  sp->flip = !sp->flip;
+               if (fabs(displacement.x) <= PHYS_EPSILON || !rectIntersectsWalls(wd, &edgesensor)) {
+                  *flags ^= MOB_FLIP;
                }
             }
          }
-         p_shot *bullet = clipWithPshots(&spiderbounds);
-         if (bullet) {
-            bullet->position.x = -1000;
-            play(sound.hit);
-            sp->hitpoints -= 1;
+         int shot = wd->spiders.shot_hit[i] - 1;
+         if (wd->pshots.atSafe(shot)) {
+            queueSpendShot(job, shot);
+            queueSound(job, sound.hit);
+            wd->spiders.hitpoints[i] -= 1;
          }
-         if (rectsOverlap(&spiderbounds, getPlayerBounds(&p1))) {
-            if (p1.position.x > sp->position.x) {
-               hurtPlayer(1, -1, 10);
+         if (rectsOverlap(&spiderbounds, &job->playerbounds)) {
+            if (wd->p1.position.x > pos->x) {
+               queueHurtPlayer(job, 1, -1, 10);
             } else {
-               hurtPlayer(-1, -1, 10);
+               queueHurtPlayer(job, -1, -1, 10);
             }
          }
       }
-      i++;
    }
-   for (int i = 0; i < countof(item); i++) {
-      item *it = tc_at(item, i);
+}
+
+// items heal the player, and whether they're taken depends on damage done
+// this tick, so they run after the enemy commands have been carried out
+void tickItems(world *wd)
+{
+   for (int i = 0; i < wd->items.count; i++) {
+      item *it = wd->items.at(i);
       rect itembounds = makeRect(it->position.x - 4, it->position.y - 8, 8, 16);
-      if (rectsOverlap(&itembounds, getPlayerBounds(&p1))) {
-         if (p1.hitpoints < 100) {
-            healPlayer(it->healamt);
-            tc_erase(item, i);
+      if (rectsOverlap(&itembounds, getPlayerBounds(wd, &wd->p1))) {
+         if (wd->p1.hitpoints < 100) {
+            healPlayer(wd, it->healamt);
+            wd->items.erase(i);
             i--;
             continue;
          }
       }
       if (it->timer >= 0) {
-         if (it->timer == 0 || !rectOnScreen(&itembounds)) {
-            tc_erase(item, i);
+         if (it->timer == 0 || !rectOnScreen(wd, &itembounds)) {
+            wd->items.erase(i);
             i--;
             continue;
          }
@@ -1919,83 +4357,203 @@ void tickEnemies()
       }
       v2 fakevelocity = makev2(0, 4);
       v2 displacement;
-      getMotionWalled(&itembounds, &fakevelocity, 0, &displacement);
+      getMotionWalled(wd, &itembounds, &fakevelocity, 0, &displacement);
       it->position = it->position + displacement;
    }
 }
 
-void drawEnemies()
+enemyjob* addEnemyJob(world *wd, enemytick tick, int start, int end, rect *playerbounds)
 {
-   for (int i = 0; i < countof(boulder); i++) {
-      boulderboss *bb = tc_at(boulder, i);
-      drawAspriteFrame(&bb->spr, bb->blocker->bounds.x, bb->blocker->bounds.y - 32, 0, 0);
+   if (wd->enemyjob_count == wd->enemyjob_max) {
+      int old = wd->enemyjob_max;
+      wd->enemyjob_max = max(old * 2, 16);
+      wd->enemyjobs = (enemyjob*)realloc(wd->enemyjobs, wd->enemyjob_max * sizeof(enemyjob));
+      memset(wd->enemyjobs + old, 0, (wd->enemyjob_max - old) * sizeof(enemyjob));
    }
-   for (int i = 0; i < countof(dozer); i++) {
-      dozermob *dz = tc_at(dozer, i);
-      if (!dz->active) {
+   enemyjob *job = wd->enemyjobs + wd->enemyjob_count++;
+   job->tick = tick;
+   job->start = start;
+   job->end = end;
+   job->playerbounds = *playerbounds;
+   job->cmds.count = 0;
+   return job;
+}
+
+// mob sets are cut into slices of a fixed size, never by thread count, so
+// the commands come back in the same order however many threads there are
+#define MOB_JOB_SIZE 64
+
+// the dead are cleared out first, swapping from the back in the order the
+// old tick loops erased them, and their death throes go in the first slice
+template <typename S>
+void addMobJobs(world *wd, S *mobs, enemytick tick, rect *playerbounds)
+{
+   enemyjob *job = addEnemyJob(wd, tick, 0, 0, playerbounds);
+   for (int i = 0; i < mobs->count;) {
+      if (mobs->hitpoints[i] < 1) {
+         queueEffect(job, ec_smalldie, mobs->position[i]);
+         queueEffect(job, ec_drop, mobs->position[i]);
+         mobs->erase(i);
+         continue;
+      }
+      i++;
+   }
+   job->end = min(mobs->count, MOB_JOB_SIZE);
+   for (int s = MOB_JOB_SIZE; s < mobs->count; s += MOB_JOB_SIZE) {
+      addEnemyJob(wd, tick, s, min(s + MOB_JOB_SIZE, mobs->count), playerbounds);
+   }
+}
+
+void runEnemyJob(void *data, int i)
+{
+   world *wd = (world*)data;
+   enemyjob *job = wd->enemyjobs + i;
+   job->tick(wd, job);
+}
+
+// each archetype (or slice of one) ticks as its own job. jobs only write
+// their own mobs and only read the walls, camera, player and shots, and
+// everything else they do comes back as commands, run in job order
+void tickEnemies(world *wd)
+{
+   Uint64 prof_start = profBegin();
+   tickBoulders(wd);
+   // the grid must not be rebuilt from inside a job
+   if (wd->wallgrid.dirty) {
+      buildWallGrid(wd);
+   }
+   rect playerbounds = *getPlayerBounds(wd, &wd->p1);
+   wd->enemyjob_count = 0;
+   addMobJobs(wd, &wd->dozers, tickDozers, &playerbounds);
+   addMobJobs(wd, &wd->bullets, tickBulletMobs, &playerbounds);
+   addMobJobs(wd, &wd->saucers, tickSaucers, &playerbounds);
+   addEnemyJob(wd, tickSmallLasers, 0, wd->slasers.count, &playerbounds);
+   addEnemyJob(wd, tickMirvRockets, 0, wd->mirvrs.count, &playerbounds);
+   addMobJobs(wd, &wd->spiders, tickSpiders, &playerbounds);
+   // the crosscheck backend counts and prints its mismatches as it goes
+   if (wd->jobs && phys_backend != pb_crosscheck) {
+      parallelFor(wd->jobs, wd->enemyjob_count, runEnemyJob, wd);
+   } else {
+      for (int i = 0; i < wd->enemyjob_count; i++) {
+         runEnemyJob(wd, i);
+      }
+   }
+   for (int i = 0; i < wd->enemyjob_count; i++) {
+      runEnemyCmds(wd, &wd->enemyjobs[i].cmds);
+   }
+   tickItems(wd);
+   profEnd(prof_enemies, prof_start);
+}
+
+void animateEnemies(world *wd)
+{
+   for (int i = 0; i < wd->dozers.count; i++) {
+      if ((wd->dozers.flags[i] & (MOB_ACTIVE | MOB_FLIPPING)) == MOB_ACTIVE) {
+         advanceAnimation(&wd->dozers.cold[i].spr, 8, 2, &wd->dozers.cold[i].frame, 0.1);
+      }
+   }
+   for (int i = 0; i < wd->bullets.count; i++) {
+      if ((wd->bullets.flags[i] & (MOB_ACTIVE | MOB_FLIPPING)) == MOB_ACTIVE) {
+         advanceAnimation(&wd->bullets.cold[i].spr, 4, 3, &wd->bullets.cold[i].frame, 0.20);
+      }
+   }
+   for (int i = 0; i < wd->saucers.count; i++) {
+      if (wd->saucers.flags[i] & MOB_ACTIVE) {
+         advanceAnimation(&wd->saucers.cold[i].spr, 0, 4, &wd->saucers.cold[i].frame, 0.10);
+      }
+   }
+   for (int i = 0; i < wd->spiders.count; i++) {
+      if ((wd->spiders.flags[i] & MOB_ACTIVE) && !wd->spiders.shot_timer[i]) {
+         advanceAnimation(&wd->spiders.cold[i].spr, 12, 3, &wd->spiders.cold[i].frame, 0.05);
+      }
+   }
+}
+
+void drawEnemies(world *wd)
+{
+   Uint64 prof_start = profBegin();
+   for (int i = 0; i < wd->boulders.count; i++) {
+      boulderboss *bb = wd->boulders.at(i);
+      rect *b = getBoulderBounds(wd, bb);
+      if (b) {
+         v2 pos = interp(wd, bb->prev_position, makev2(b->x, b->y));
+         drawAspriteFrame(wd, &bb->spr, pos.x, pos.y - 32, 0, 0);
+      }
+   }
+   for (int i = 0; i < wd->dozers.count; i++) {
+      int flags = wd->dozers.flags[i];
+      if (!(flags & MOB_ACTIVE)) {
          continue;
       }
-      if (!dz->flipping) {
-         dz->frame += 0.1;
-         drawAnimatingAsprite(&dz->spr, dz->position.x - 8, dz->position.y - 8, 8, 2, &dz->frame, dz->flip);
+      mobsprite *ms = wd->dozers.cold + i;
+      v2 pos = interp(wd, wd->dozers.prev_position[i], wd->dozers.position[i]);
+      if (!(flags & MOB_FLIPPING)) {
+         drawAnimatingAsprite(wd, &ms->spr, pos.x - 8, pos.y - 8, 8, 2, ms->frame, flags & MOB_FLIP);
       } else {
-         drawAspriteFrame(&dz->spr, dz->position.x - 8, dz->position.y - 8, 10, dz->flip);
+         drawAspriteFrame(wd, &ms->spr, pos.x - 8, pos.y - 8, 10, flags & MOB_FLIP);
       }
    }
-   for (int i = 0; i < countof(bullet); i++) {
-      bulletmob *b = tc_at(bullet, i);
-      if (!b->active) {
+   for (int i = 0; i < wd->bullets.count; i++) {
+      int flags = wd->bullets.flags[i];
+      if (!(flags & MOB_ACTIVE)) {
          continue;
       }
-      if (!b->flipping) {
-         b->frame += 0.20;
-         drawAnimatingAsprite(&b->spr, b->position.x - 8, b->position.y - 8, 4, 3, &b->frame, b->flip);
+      mobsprite *ms = wd->bullets.cold + i;
+      v2 pos = interp(wd, wd->bullets.prev_position[i], wd->bullets.position[i]);
+      if (!(flags & MOB_FLIPPING)) {
+         drawAnimatingAsprite(wd, &ms->spr, pos.x - 8, pos.y - 8, 4, 3, ms->frame, flags & MOB_FLIP);
       } else {
-         drawAspriteFrame(&b->spr, b->position.x - 8, b->position.y - 8, 7, b->flip);
+         drawAspriteFrame(wd, &ms->spr, pos.x - 8, pos.y - 8, 7, flags & MOB_FLIP);
       }
    }
-   for (int i = 0; i < countof(saucer); i++) {
-      saucermob *s = tc_at(saucer, i);
-      if (!s->active) {
+   for (int i = 0; i < wd->saucers.count; i++) {
+      if (!(wd->saucers.flags[i] & MOB_ACTIVE)) {
          continue;
       }
-      s->frame += 0.10;
-      drawAnimatingAsprite(&s->spr, s->position.x - 8, s->position.y - 8, 0, 4, &s->frame, 0);
+      mobsprite *ms = wd->saucers.cold + i;
+      v2 pos = interp(wd, wd->saucers.prev_position[i], wd->saucers.position[i]);
+      drawAnimatingAsprite(wd, &ms->spr, pos.x - 8, pos.y - 8, 0, 4, ms->frame, 0);
    }
-   for (int i = 0; i < countof(slaser); i++) {
-      slaser *sl = tc_at(slaser, i);
-      drawAspriteFrame(&sl->spr, sl->position.x - 8, sl->position.y - 8, 11, sl->hspeed < 0.f);
+   for (int i = 0; i < wd->slasers.count; i++) {
+      slaser *sl = wd->slasers.at(i);
+      v2 pos = interp(wd, sl->prev_position, sl->position);
+      drawAspriteFrame(wd, &sl->spr, pos.x - 8, pos.y - 8, 11, sl->hspeed < 0.f);
    }
-   for (int i = 0; i < countof(spider); i++) {
-      spidermob *sp = tc_at(spider, i);
-      if (!sp->active) {
+   for (int i = 0; i < wd->spiders.count; i++) {
+      int flags = wd->spiders.flags[i];
+      if (!(flags & MOB_ACTIVE)) {
          continue;
       }
-      if (sp->shot_timer) {
-         if (sp->shot_timer > 40) {
-            drawAspriteFrame(&sp->spr, sp->position.x - 8, sp->position.y - 8, 15, sp->flip);
+      mobsprite *ms = wd->spiders.cold + i;
+      v2 pos = interp(wd, wd->spiders.prev_position[i], wd->spiders.position[i]);
+      int shot_timer = wd->spiders.shot_timer[i];
+      if (shot_timer) {
+         if (shot_timer > 40) {
+            drawAspriteFrame(wd, &ms->spr, pos.x - 8, pos.y - 8, 15, flags & MOB_FLIP);
          } else {
-            drawAspriteFrame(&sp->spr, sp->position.x - 8, sp->position.y - 8, 12, sp->flip);
+            drawAspriteFrame(wd, &ms->spr, pos.x - 8, pos.y - 8, 12, flags & MOB_FLIP);
          }
       } else {
-         sp->frame += 0.05;
-         drawAnimatingAsprite(&sp->spr, sp->position.x - 8, sp->position.y - 8, 12, 3, &sp->frame, sp->flip);
+         drawAnimatingAsprite(wd, &ms->spr, pos.x - 8, pos.y - 8, 12, 3, ms->frame, flags & MOB_FLIP);
       }
    }
-   for (int i = 0; i < countof(item); i++) {
-      item *it = tc_at(item, i);
+   for (int i = 0; i < wd->items.count; i++) {
+      item *it = wd->items.at(i);
+      v2 pos = interp(wd, it->prev_position, it->position);
       if (it->timer > 100 || it->timer < 0) {
-         drawAspriteFrame(&it->spr, it->position.x - 8, it->position.y - 8, it->frame[(frame/8)%2], 0);
+         drawAspriteFrame(wd, &it->spr, pos.x - 8, pos.y - 8, it->frame[(wd->frame/8)%2], 0);
       } else {
-         if ((frame/8)%2) {
-            drawAspriteFrame(&it->spr, it->position.x - 8, it->position.y - 8, it->frame[(frame/8)%2], 0);
+         if ((wd->frame/8)%2) {
+            drawAspriteFrame(wd, &it->spr, pos.x - 8, pos.y - 8, it->frame[(wd->frame/8)%2], 0);
          }
       }
    }
-   for (int i = 0; i < countof(mirvr); i++) {
-      mirvrocket *mr = tc_at(mirvr, i);
-      drawAspriteFrame(&mr->spr, mr->position.x - 8, mr->position.y - 8, mr->direction, 0);
+   for (int i = 0; i < wd->mirvrs.count; i++) {
+      mirvrocket *mr = wd->mirvrs.at(i);
+      v2 pos = interp(wd, mr->prev_position, mr->position);
+      drawAspriteFrame(wd, &mr->spr, pos.x - 8, pos.y - 8, mr->direction, 0);
    }
+   profEnd(prof_draw_enemies, prof_start);
 }
 
 enum mirv_actions {
@@ -2011,245 +4569,227 @@ enum mirv_actions {
    ma_count
 };
 
-struct mirv_s{
-   asprite spr;
-   v2 position;
-   int active;
-   int state; 
-   int timer;
-   int hurttimer;
-   int hitpoints;
-   int flip;
-   float frame;
-   float orbit;
-   v2 velocity;
-} mirv;
+rect getMirvBounds(world *wd)
+{
+   return makeRect(wd->mirv.position.x - 8, wd->mirv.position.y - 8, 16, 24);
+}
 
-void startMirv(float x, float y)
+void startMirv(world *wd, float x, float y)
 {
-   memset(&mirv, 0, sizeof(mirv_s));
-   mirv.spr = createAsprite(tex.mirv, 32, 32);
-   mirv.active = 1;
-   mirv.position = makev2(x, y);
-   mirv.hitpoints = 100;
+   memset(&wd->mirv, 0, sizeof(mirv_s));
+   wd->mirv.spr = createAsprite(tex.mirv, 32, 32);
+   wd->mirv.active = 1;
+   wd->mirv.position = makev2(x, y);
+   wd->mirv.hitpoints = 100;
 }
 
-void doMirv()
+void tickMirv(world *wd)
 {
-   if (mirv.active) {
-      v2 drawpos = makev2(mirv.position.x - 16, mirv.position.y - 16);
-      rect mirvbounds = makeRect(mirv.position.x - 8, mirv.position.y - 8, 16, 24);
+   Uint64 prof_start = profBegin();
+   if (wd->mirv.active) {
+      rect mirvbounds = getMirvBounds(wd);
 
-      if (p1.position.x < mirv.position.x) {
-         mirv.flip = 1;
+      if (wd->p1.position.x < wd->mirv.position.x) {
+         wd->mirv.flip = 1;
       } else {
-         mirv.flip = 0;
+         wd->mirv.flip = 0;
       }
 
-      if (rectsOverlap(getPlayerBounds(&p1), &mirvbounds)) {
-         if (mirv.flip) {
-            hurtPlayer(-2, -4, 30);
+      if (rectsOverlap(getPlayerBounds(wd, &wd->p1), &mirvbounds)) {
+         if (wd->mirv.flip) {
+            hurtPlayer(wd, -2, -4, 30);
          } else {
-            hurtPlayer(2, -4, 30);
+            hurtPlayer(wd, 2, -4, 30);
          }
       }
 
 
-      if (!mirv.hurttimer) {
-         p_shot *shot = clipWithPshots(&mirvbounds);
+      if (!wd->mirv.hurttimer) {
+         p_shot *shot = wd->pshots.atSafe(wd->mirv.shot_hit - 1);
             if (shot) {
                play(sound.hit);
-               shot->position.x = -1000;
-               mirv.hitpoints = max(0, mirv.hitpoints - 5);
-               mirv.hurttimer = 40;
+               spendShot(shot);
+               wd->mirv.hitpoints = max(0, wd->mirv.hitpoints - 5);
+               wd->mirv.hurttimer = 40;
             }
-            if (!mirv.hitpoints) {
+            if (!wd->mirv.hitpoints) {
                play(sound.mirv_die);
-               effect_explode_large(mirv.position);
-               mirv.active = 0;
+               effect_explode_large(wd, wd->mirv.position);
+               wd->mirv.active = 0;
             }
       } else {
-         mirv.hurttimer -= 1;
+         wd->mirv.hurttimer -= 1;
       }
 
-      if (mirv.timer > 0) {
-         mirv.timer--;
+      if (wd->mirv.timer > 0) {
+         wd->mirv.timer--;
       }
 
       float gravity = 0.05;
       float hover = 150;
 
-      if (mirv.hitpoints <= 40) {
+      if (wd->mirv.hitpoints <= 40) {
          hover = 200;
          gravity = 0.08;
       }
 
-      if ((mirv.hurttimer/2)%2) {
-         drawAspriteFrame(&mirv.spr, drawpos.x, drawpos.y, 2, mirv.flip);
-      } else {
-         switch (mirv.state) {
+      // the state machine sits out the frames mirv blinks on after a hit
+      if (!((wd->mirv.hurttimer/2)%2)) {
+         switch (wd->mirv.state) {
             case ma_entry:
                {
-                  mirv.velocity.y += gravity;
-                  if (mirv.hitpoints < 100) {
-                     mirv.state = ma_taunt;
-                     mirv.timer = 30;
+                  wd->mirv.velocity.y += gravity;
+                  if (wd->mirv.hitpoints < 100) {
+                     wd->mirv.state = ma_taunt;
+                     wd->mirv.timer = 30;
                   }
-                  drawAspriteFrame(&mirv.spr, drawpos.x, drawpos.y, 0, mirv.flip);
                }break;
             case ma_taunt:
                {
-                  mirv.velocity.y += gravity;
-                  if (!mirv.timer) {
+                  wd->mirv.velocity.y += gravity;
+                  if (!wd->mirv.timer) {
                      play(sound.mirv_engine);
-                     mirv.state = ma_takeoff;
-                     mirv.orbit = mirv.position.x - 4;
+                     wd->mirv.state = ma_takeoff;
+                     wd->mirv.orbit = wd->mirv.position.x - 4;
                   }
-                  drawAspriteFrame(&mirv.spr, drawpos.x, drawpos.y, 1, mirv.flip);
                }break;
             case ma_fly:
                {
-                  if (p1.position.x < 150) {
-                     mirv.orbit = p1.position.x + 100;
-                  } else if (p1.position.x > room.bounds.w - 150) {
-                     mirv.orbit = p1.position.x - 100;
+                  if (wd->p1.position.x < 150) {
+                     wd->mirv.orbit = wd->p1.position.x + 100;
+                  } else if (wd->p1.position.x > wd->room.bounds.w - 150) {
+                     wd->mirv.orbit = wd->p1.position.x - 100;
                   } else {
-                     if ((frame/1000)%2) {
-                        mirv.orbit = p1.position.x - 100;
+                     if ((wd->frame/1000)%2) {
+                        wd->mirv.orbit = wd->p1.position.x - 100;
                      } else {
-                        mirv.orbit = p1.position.x + 100;
+                        wd->mirv.orbit = wd->p1.position.x + 100;
                      }
                   }
-                  if (mirv.hitpoints > 50) {
-                     if (mirv.position.x < p1.position.x && mirv.orbit > p1.position.x) {
+                  if (wd->mirv.hitpoints > 50) {
+                     if (wd->mirv.position.x < wd->p1.position.x && wd->mirv.orbit > wd->p1.position.x) {
                         hover = 16;
-                     } else if (mirv.position.x > p1.position.x && mirv.orbit < p1.position.x) {
+                     } else if (wd->mirv.position.x > wd->p1.position.x && wd->mirv.orbit < wd->p1.position.x) {
                         hover = 16;
                      }
                   }
-                  if (mirv.position.x > mirv.orbit) {
-                     mirv.velocity.x = fapproach(mirv.velocity.x, -1, 0.01);
+                  if (wd->mirv.position.x > wd->mirv.orbit) {
+                     wd->mirv.velocity.x = fapproach(wd->mirv.velocity.x, -1, 0.01);
                   } else {
-                     mirv.velocity.x = fapproach(mirv.velocity.x, 1, 0.01);
+                     wd->mirv.velocity.x = fapproach(wd->mirv.velocity.x, 1, 0.01);
                   }
-                  if (mirv.position.y > p1.position.y - hover) {
-                     mirv.velocity.y = fapproach(mirv.velocity.y, -1, 0.01);
+                  if (wd->mirv.position.y > wd->p1.position.y - hover) {
+                     wd->mirv.velocity.y = fapproach(wd->mirv.velocity.y, -1, 0.01);
                   } else {
-                     mirv.velocity.y = fapproach(mirv.velocity.y, 1, 0.01);
+                     wd->mirv.velocity.y = fapproach(wd->mirv.velocity.y, 1, 0.01);
                   }
-                  if (!mirv.timer) {
-                     if ((rand() % 100) < 45) {
-                        mirv.state = ma_rise;
+                  if (!wd->mirv.timer) {
+                     if ((worldRand(wd) % 100) < 45) {
+                        wd->mirv.state = ma_rise;
                         play(sound.mirv_engine);
                      } else {
-                        mirv.state = ma_findland;
+                        wd->mirv.state = ma_findland;
                      }
                   }
-                  if (mirv.position.y > p1.position.y - hover) {
-                     mirv.frame += 0.3;
+                  if (wd->mirv.position.y > wd->p1.position.y - hover) {
+                     advanceAnimation(&wd->mirv.spr, 4, 4, &wd->mirv.frame, 0.3);
                   } else {
-                     mirv.frame += 0.2;
+                     advanceAnimation(&wd->mirv.spr, 4, 4, &wd->mirv.frame, 0.2);
                   }
-                  drawAnimatingAsprite(&mirv.spr, drawpos.x, drawpos.y, 4, 4, &mirv.frame, mirv.flip);
                }break;
             case ma_dive:
                {
-                  mirv.frame += 0.1;
-                  drawAnimatingAsprite(&mirv.spr, drawpos.x, drawpos.y, 4, 4, &mirv.frame, mirv.flip);
+                  advanceAnimation(&wd->mirv.spr, 4, 4, &wd->mirv.frame, 0.1);
                }break;
             case ma_findland:
                {
-                  mirv.velocity.y += gravity;
-                  if (rectOnGround(&mirvbounds)) {
-                     mirv.velocity.x = 0;
-                     mirv.state = ma_shotgun;
-                     mirv.timer = 20;
+                  wd->mirv.velocity.y += gravity;
+                  if (rectOnGround(wd, &mirvbounds)) {
+                     wd->mirv.velocity.x = 0;
+                     wd->mirv.state = ma_shotgun;
+                     wd->mirv.timer = 20;
                      play(sound.mirv_shotgun);
-                     if (mirv.flip) {
-                        fireMirvRocket(mirv.position.x - 16, mirv.position.y, -3, -1, 2);
-                        fireMirvRocket(mirv.position.x - 16, mirv.position.y, -3, 0, 2);
-                        fireMirvRocket(mirv.position.x - 16, mirv.position.y, -3, 1, 2);
+                     if (wd->mirv.flip) {
+                        fireMirvRocket(wd, wd->mirv.position.x - 16, wd->mirv.position.y, -3, -1, 2);
+                        fireMirvRocket(wd, wd->mirv.position.x - 16, wd->mirv.position.y, -3, 0, 2);
+                        fireMirvRocket(wd, wd->mirv.position.x - 16, wd->mirv.position.y, -3, 1, 2);
                      } else {
-                        fireMirvRocket(mirv.position.x + 16, mirv.position.y,  3, -1, 0);
-                        fireMirvRocket(mirv.position.x + 16, mirv.position.y,  3, 0, 0);
-                        fireMirvRocket(mirv.position.x + 16, mirv.position.y,  3, 1, 0);
+                        fireMirvRocket(wd, wd->mirv.position.x + 16, wd->mirv.position.y,  3, -1, 0);
+                        fireMirvRocket(wd, wd->mirv.position.x + 16, wd->mirv.position.y,  3, 0, 0);
+                        fireMirvRocket(wd, wd->mirv.position.x + 16, wd->mirv.position.y,  3, 1, 0);
                      }
                   }
-                  drawAspriteFrame(&mirv.spr, drawpos.x, drawpos.y, 4, mirv.flip);
                }break;
             case ma_shotgun:
                {
-                  if (!mirv.timer) {
-                     mirv.timer = 50;
-                     mirv.state = ma_taunt;
+                  if (!wd->mirv.timer) {
+                     wd->mirv.timer = 50;
+                     wd->mirv.state = ma_taunt;
                   }
-                  drawAspriteFrame(&mirv.spr, drawpos.x, drawpos.y, 3, mirv.flip);
                }break;
             case ma_takeoff:
                {
-                  if (mirv.position.y < p1.position.y - hover) {
-                     mirv.state = ma_fly;
-                     if (mirv.hitpoints > 50) {
-                        mirv.timer = 500 + (rand() % 1000);
+                  if (wd->mirv.position.y < wd->p1.position.y - hover) {
+                     wd->mirv.state = ma_fly;
+                     if (wd->mirv.hitpoints > 50) {
+                        wd->mirv.timer = 500 + (worldRand(wd) % 1000);
                      } else {
-                        mirv.timer = 100 + (rand() % 400);
+                        wd->mirv.timer = 100 + (worldRand(wd) % 400);
                      }
                   }
-                  if (mirv.position.x > mirv.orbit) {
-                     mirv.velocity.x = fapproach(mirv.velocity.x, -1, 0.01);
+                  if (wd->mirv.position.x > wd->mirv.orbit) {
+                     wd->mirv.velocity.x = fapproach(wd->mirv.velocity.x, -1, 0.01);
                   } else {
-                     mirv.velocity.x = fapproach(mirv.velocity.x, 1, 0.01);
+                     wd->mirv.velocity.x = fapproach(wd->mirv.velocity.x, 1, 0.01);
                   }
-                  mirv.velocity.y = fapproach(mirv.velocity.y, -1, 0.01);
-                  mirv.frame += 0.6;
-                  drawAnimatingAsprite(&mirv.spr, drawpos.x, drawpos.y, 4, 4, &mirv.frame, mirv.flip);
+                  wd->mirv.velocity.y = fapproach(wd->mirv.velocity.y, -1, 0.01);
+                  advanceAnimation(&wd->mirv.spr, 4, 4, &wd->mirv.frame, 0.6);
                }break;
             case ma_rise:
                {
-                  if (mirv.position.y < p1.position.y - 2*hover) {
-                     mirv.state = ma_bomb;
-                     mirv.timer = 20;
-                     float startx = p1.position.x - 300;
-                     float maxx = p1.position.x + 300;
-                     float launchy = camera.position.y - 16;
+                  if (wd->mirv.position.y < wd->p1.position.y - 2*hover) {
+                     wd->mirv.state = ma_bomb;
+                     wd->mirv.timer = 20;
+                     float startx = wd->p1.position.x - 300;
+                     float maxx = wd->p1.position.x + 300;
+                     float launchy = wd->camera.position.y - 16;
                      int bombwaves;
-                     if (mirv.hitpoints > 60) {
+                     if (wd->mirv.hitpoints > 60) {
                         bombwaves = 1;
-                     } else if (mirv.hitpoints > 30) {
+                     } else if (wd->mirv.hitpoints > 30) {
                         bombwaves = 2;
                      } else {
                         bombwaves = 3;
                      }
                      for (int i = 0; i < bombwaves; i++) {
                         for (float lx = startx; lx < maxx; lx += 32) {
-                           switch (rand() % 3) {
+                           switch (worldRand(wd) % 3) {
                               case 0:
-                                 fireMirvRocket(lx, launchy, -0.1, 2, 3);
+                                 fireMirvRocket(wd, lx, launchy, -0.1, 2, 3);
                                  break;
                               case 1:
-                                 fireMirvRocket(lx, launchy, 0, 2, 3);
+                                 fireMirvRocket(wd, lx, launchy, 0, 2, 3);
                                  break;
                               case 2:
-                                 fireMirvRocket(lx, launchy, 0.1, 2, 3);
+                                 fireMirvRocket(wd, lx, launchy, 0.1, 2, 3);
                                  break;
                            }
                         }
                         launchy -= 120;
                      }
                   }
-                  mirv.velocity.x = fapproach(mirv.velocity.x, 0, 0.05);
-                  mirv.velocity.y = fapproach(mirv.velocity.y, -1, 0.01);
-                  mirv.frame += 0.6;
-                  drawAnimatingAsprite(&mirv.spr, drawpos.x, drawpos.y, 4, 4, &mirv.frame, mirv.flip);
+                  wd->mirv.velocity.x = fapproach(wd->mirv.velocity.x, 0, 0.05);
+                  wd->mirv.velocity.y = fapproach(wd->mirv.velocity.y, -1, 0.01);
+                  advanceAnimation(&wd->mirv.spr, 4, 4, &wd->mirv.frame, 0.6);
                }break;
             case ma_bomb:
                {
-                  if (!mirv.timer) {
-                     mirv.state = ma_fly;
-                     if (mirv.hitpoints > 50) {
-                        mirv.timer = 500 + (rand() % 1000);
+                  if (!wd->mirv.timer) {
+                     wd->mirv.state = ma_fly;
+                     if (wd->mirv.hitpoints > 50) {
+                        wd->mirv.timer = 500 + (worldRand(wd) % 1000);
                      } else {
-                        mirv.timer = 100 + (rand() % 400);
+                        wd->mirv.timer = 100 + (worldRand(wd) % 400);
                      }
                   }
                }break;
@@ -2258,532 +4798,2984 @@ void doMirv()
          }
       }
       v2 displacement;
-      getMotionWalled(&mirvbounds, &mirv.velocity, &mirv.velocity, &displacement);
-      mirv.position = mirv.position + displacement;
-
-      SDL_Rect healthrect;
-      SDL_Rect healthbar;
-      healthrect.x = healthbar.x = field_w - 8;
-      healthrect.y = healthbar.y = 4;
-      healthrect.w = healthbar.w = 4;
-      healthrect.h = 100;
-      healthbar.h = mirv.hitpoints;
-      healthbar.y += healthrect.h - healthbar.h;
-      SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
-      SDL_RenderFillRect(ren, &healthrect);
-      SDL_SetRenderDrawColor(ren, 255, 255, 100, 255);
-      SDL_RenderFillRect(ren, &healthbar);
-      SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
-      SDL_RenderDrawRect(ren, &healthrect);
-   }
-}
-
-void clearEnemies()
-{
-   countof(boulder) = 0;
-   countof(dozer) = 0;
-   countof(bullet) = 0;
-   countof(saucer) = 0;
-   countof(slaser) = 0;
-   countof(spider) = 0;
-   countof(item) = 0;
-   mirv.active = 0;
+      getMotionWalled(wd, &mirvbounds, &wd->mirv.velocity, &wd->mirv.velocity, &displacement);
+      wd->mirv.position = wd->mirv.position + displacement;
+   }
+   profEnd(prof_mirv, prof_start);
+}
+
+void drawMirv(world *wd)
+{
+   if (!wd->mirv.active) {
+      return;
+   }
+   v2 drawpos = interp(wd, wd->mirv.prev_position, wd->mirv.position) - makev2(16, 16);
+   if ((wd->mirv.hurttimer/2)%2) {
+      drawAspriteFrame(wd, &wd->mirv.spr, drawpos.x, drawpos.y, 2, wd->mirv.flip);
+   } else {
+      switch (wd->mirv.state) {
+         case ma_entry:
+            drawAspriteFrame(wd, &wd->mirv.spr, drawpos.x, drawpos.y, 0, wd->mirv.flip);
+            break;
+         case ma_taunt:
+            drawAspriteFrame(wd, &wd->mirv.spr, drawpos.x, drawpos.y, 1, wd->mirv.flip);
+            break;
+         case ma_findland:
+            drawAspriteFrame(wd, &wd->mirv.spr, drawpos.x, drawpos.y, 4, wd->mirv.flip);
+            break;
+         case ma_shotgun:
+            drawAspriteFrame(wd, &wd->mirv.spr, drawpos.x, drawpos.y, 3, wd->mirv.flip);
+            break;
+         case ma_fly:
+         case ma_dive:
+         case ma_takeoff:
+         case ma_rise:
+            drawAnimatingAsprite(wd, &wd->mirv.spr, drawpos.x, drawpos.y, 4, 4, wd->mirv.frame, wd->mirv.flip);
+            break;
+         default:
+            break;
+      }
+   }
+
+   SDL_Rect healthrect;
+   SDL_Rect healthbar;
+   healthrect.x = healthbar.x = field_w - 8;
+   healthrect.y = healthbar.y = 4;
+   healthrect.w = healthbar.w = 4;
+   healthrect.h = 100;
+   healthbar.h = wd->mirv.hitpoints;
+   healthbar.y += healthrect.h - healthbar.h;
+   fillScreenRect(&healthrect, 0, 0, 0);
+   fillScreenRect(&healthbar, 255, 255, 100);
+   outlineScreenRect(&healthrect, 0, 0, 0);
+}
+
+// player shot hits for the whole tick are worked out in one sort and sweep
+// pass after stepPshots(). every hittable enemy gets the index + 1 of the
+// shot that hits it in shot_hit. enemies claim shots in the order their
+// tick loops visit them, each taking the lowest numbered shot still free,
+// which is what the old per-enemy scans over the shot list did.
+void addHittable(world *wd, rect bounds, int *shot_hit)
+{
+   if (wd->shothits.count == wd->shothits.max) {
+      wd->shothits.max = max(wd->shothits.max * 2, 64);
+      wd->shothits.items = (hittable*)realloc(wd->shothits.items, wd->shothits.max * sizeof(hittable));
+   }
+   hittable *h = wd->shothits.items + wd->shothits.count++;
+   h->bounds = bounds;
+   h->shot_hit = shot_hit;
+}
+
+void addShotPair(world *wd, int slot, int shot)
+{
+   if (wd->shothits.pair_count == wd->shothits.pair_max) {
+      wd->shothits.pair_max = max(wd->shothits.pair_max * 2, 64);
+      wd->shothits.pairs = (shotpair*)realloc(wd->shothits.pairs, wd->shothits.pair_max * sizeof(shotpair));
+   }
+   wd->shothits.pairs[wd->shothits.pair_count].slot = slot;
+   wd->shothits.pairs[wd->shothits.pair_count].shot = shot;
+   wd->shothits.pair_count++;
+}
+
+int* getVisitScratch(world *wd, int count)
+{
+   if (count > wd->shothits.perm_max) {
+      wd->shothits.perm_max = count;
+      wd->shothits.perm = (int*)realloc(wd->shothits.perm, count * sizeof(int));
+   }
+   for (int i = 0; i < count; i++) {
+      wd->shothits.perm[i] = i;
+   }
+   return wd->shothits.perm;
+}
+
+// tick loops erase dead mobs with a swap from the back before looking at
+// them, so walk the pool in that same order and only keep live, on screen ones
+#define add_mob_hittables(mobs, boundsfn) \
+   { \
+      int n = mobs.count; \
+      int *perm = getVisitScratch(wd, n); \
+      for (int i = 0; i < n;) { \
+         int m = perm[i]; \
+         if (mobs.hitpoints[m] < 1) { \
+            perm[i] = perm[--n]; \
+            continue; \
+         } \
+         rect b = boundsfn(wd, m); \
+         if (rectOnScreen(wd, &b)) { \
+            addHittable(wd, b, mobs.shot_hit + m); \
+         } \
+         i++; \
+      } \
+   }
+
+int compareSweepEntries(const void *a, const void *b)
+{
+   const sweepentry *ea = (const sweepentry*)a;
+   const sweepentry *eb = (const sweepentry*)b;
+   return (ea->minx > eb->minx) - (ea->minx < eb->minx);
+}
+
+int compareShotPairs(const void *a, const void *b)
+{
+   const shotpair *pa = (const shotpair*)a;
+   const shotpair *pb = (const shotpair*)b;
+   if (pa->slot != pb->slot) {
+      return pa->slot - pb->slot;
+   }
+   return pa->shot - pb->shot;
+}
+
+void resolvePshotHits(world *wd)
+{
+   for (int i = 0; i < wd->boulders.count; i++) {
+      wd->boulders.at(i)->shot_hit = 0;
+   }
+   for (int i = 0; i < wd->dozers.count; i++) {
+      wd->dozers.shot_hit[i] = 0;
+   }
+   for (int i = 0; i < wd->bullets.count; i++) {
+      wd->bullets.shot_hit[i] = 0;
+   }
+   for (int i = 0; i < wd->saucers.count; i++) {
+      wd->saucers.shot_hit[i] = 0;
+   }
+   for (int i = 0; i < wd->spiders.count; i++) {
+      wd->spiders.shot_hit[i] = 0;
+   }
+   wd->mirv.shot_hit = 0;
+   if (wd->pshots.empty()) {
+      return;
+   }
+
+   // same order as tickEnemies(wd), then tickMirv(wd)
+   wd->shothits.count = 0;
+   // there's only ever one boulder, and it's erased after its own hit
+   for (int i = 0; i < wd->boulders.count; i++) {
+      boulderboss *bb = wd->boulders.at(i);
+      rect *b = getBoulderBounds(wd, bb);
+      if (b) {
+         addHittable(wd, *b, &bb->shot_hit);
+      }
+   }
+   add_mob_hittables(wd->dozers, getDozerBounds);
+   add_mob_hittables(wd->bullets, getBulletMobBounds);
+   add_mob_hittables(wd->saucers, getSaucerBounds);
+   add_mob_hittables(wd->spiders, getSpiderBounds);
+   if (wd->mirv.active && !wd->mirv.hurttimer) {
+      addHittable(wd, getMirvBounds(wd), &wd->mirv.shot_hit);
+   }
+
+   int total = wd->shothits.count + wd->pshots.count;
+   if (wd->shothits.count + wd->pshots.limit > wd->shothits.shot_max) {
+      wd->shothits.shot_max = wd->shothits.count + wd->pshots.limit;
+      wd->shothits.entries = (sweepentry*)realloc(wd->shothits.entries, wd->shothits.shot_max * sizeof(sweepentry));
+      wd->shothits.active_shots = (int*)realloc(wd->shothits.active_shots, wd->shothits.shot_max * sizeof(int));
+      wd->shothits.active_slots = (int*)realloc(wd->shothits.active_slots, wd->shothits.shot_max * sizeof(int));
+      wd->shothits.spent = (char*)realloc(wd->shothits.spent, wd->shothits.shot_max);
+   }
+   sweepentry *e = wd->shothits.entries;
+   for (int i = 0; i < wd->shothits.count; i++) {
+      rect *b = &wd->shothits.items[i].bounds;
+      e->minx = b->x;
+      e->maxx = b->x + b->w;
+      e->shot = -1;
+      e->slot = i;
+      e++;
+   }
+   for (int i = 0; i < wd->pshots.count; i++) {
+      rect *b = getPshotBounds(wd, wd->pshots.at(i));
+      e->minx = b->x;
+      e->maxx = b->x + b->w;
+      e->shot = i;
+      e->slot = -1;
+      e++;
+   }
+   qsort(wd->shothits.entries, total, sizeof(sweepentry), compareSweepEntries);
+
+   // sweep along x, keeping the shots and hittables whose spans are still open
+   int shot_count = 0;
+   int slot_count = 0;
+   wd->shothits.pair_count = 0;
+   for (int i = 0; i < total; i++) {
+      sweepentry *cur = wd->shothits.entries + i;
+      int *open = (cur->shot < 0)?wd->shothits.active_shots:wd->shothits.active_slots;
+      int *open_count = (cur->shot < 0)?&shot_count:&slot_count;
+      for (int j = 0; j < *open_count;) {
+         int k = open[j];
+         rect *b = (cur->shot < 0)?getPshotBounds(wd, wd->pshots.at(k)):&wd->shothits.items[k].bounds;
+         if (b->x + b->w < cur->minx) {
+            open[j] = open[--(*open_count)];
+            continue;
+         }
+         if (cur->shot < 0) {
+            if (rectsOverlap(&wd->shothits.items[cur->slot].bounds, b)) {
+               addShotPair(wd, cur->slot, k);
+            }
+         } else {
+            if (rectsOverlap(b, getPshotBounds(wd, wd->pshots.at(cur->shot)))) {
+               addShotPair(wd, k, cur->shot);
+            }
+         }
+         j++;
+      }
+      if (cur->shot < 0) {
+         wd->shothits.active_slots[slot_count++] = cur->slot;
+      } else {
+         wd->shothits.active_shots[shot_count++] = cur->shot;
+      }
+   }
+
+   qsort(wd->shothits.pairs, wd->shothits.pair_count, sizeof(shotpair), compareShotPairs);
+   memset(wd->shothits.spent, 0, wd->pshots.count);
+   for (int i = 0; i < wd->shothits.pair_count; i++) {
+      shotpair *sp = wd->shothits.pairs + i;
+      int *hit = wd->shothits.items[sp->slot].shot_hit;
+      if (!*hit && !wd->shothits.spent[sp->shot]) {
+         *hit = sp->shot + 1;
+         wd->shothits.spent[sp->shot] = 1;
+      }
+   }
+}
+
+void clearEnemies(world *wd)
+{
+   wd->boulders.clear();
+   wd->dozers.clear();
+   wd->bullets.clear();
+   wd->saucers.clear();
+   wd->slasers.clear();
+   wd->spiders.clear();
+   wd->items.clear();
+   wd->mirv.active = 0;
+}
+
+// how many tile_size images a tileset holds
+int tileSamples(atlasimage t)
+{
+   int tw = t.tex?t.rect.w:tile_size;
+   int th = t.tex?t.rect.h:tile_size;
+   return (tw / tile_size) * (th / tile_size);
+}
+
+void initTilemap(world *wd, int screens_w, int screens_h, atlasimage tex)
+{
+   free(wd->tilemap.data);
+   free(wd->tilemap.solid);
+
+   wd->tilemap.width  = screens_w * field_w_tiles;
+   wd->tilemap.height = screens_h * field_h_tiles;
+   wd->tilemap.size = wd->tilemap.width * wd->tilemap.height;
+   wd->tilemap.data = (char*)calloc(wd->tilemap.size, sizeof(char));
+   wd->tilemap.solid = (unsigned char*)calloc((wd->tilemap.size + 7) / 8, sizeof(char));
+
+   wd->tilemap.rng = screens_w + screens_h;
+   wd->tilemap.tex = tex;
+   wd->tilemap.tex_pitch = (tex.tex?tex.rect.w:tile_size) / tile_size;
+   wd->tilemap.tex_samplecount = tileSamples(tex);
+}
+
+void setRandomTile(tilemap_s *tm, int x, int y)
+{
+   assert(x >= 0 && x < tm->width && y >= 0 && y < tm->height);
+   tm->rng = tm->rng * 1103515245 + 12345;
+   tm->data[x + y * tm->width] = ((tm->rng >> 16) % tm->tex_samplecount) + 1;
+}
+
+void setRandomRectangle(tilemap_s *tm, int x, int y, int w, int h)
+{
+   int xs = max(x, 0);
+   int ys = max(y, 0);
+   int xm = min(tm->width,  x + w);
+   int ym = min(tm->height, y + h);
+   for (y = ys; y < ym; y++) {
+      for (x = xs; x < xm; x++) {
+         setRandomTile(tm, x, y);
+      }
+   }
+}
+
+void buildTileList(world *wd, v2 camera)
+{
+   tilelist_s *tl = &wd->tilelist;
+   tl->count = 0;
+   tl->loads = wd->loads;
+   tl->camera = camera;
+   if (wd->tilemap.data) {
+      int screens_w = wd->tilemap.width / (field_w_tiles);
+      int screens_h = wd->tilemap.height / (field_h_tiles);
+      int ofsx = floor(camera.x);
+      int ofsy = floor(camera.y);
+      int xs = max((int)floor((float)ofsx / field_w), 0);
+      int ys = max((int)floor((float)ofsy / field_h), 0);
+      int xm = min((int)floor((float)(ofsx + field_w - 1) / field_w), screens_w - 1);
+      int ym = min((int)floor((float)(ofsy + field_h - 1) / field_h), screens_h - 1);
+      for (int y = ys; y <= ym; y++) {
+         for (int x = xs; x <= xm; x++) {
+            tl->screens[tl->count] = x + y * screens_w;
+            tl->dst[tl->count].x = x * field_w - ofsx;
+            tl->dst[tl->count].y = y * field_h - ofsy;
+            tl->dst[tl->count].w = field_w;
+            tl->dst[tl->count].h = field_h;
+            tl->count++;
+         }
+      }
+   }
+}
+
+void invalidateTileChunks()
+{
+   for (int i = 0; i < tilechunk_count; i++) {
+      tilechunks[i].screen = -1;
+   }
+}
+
+// for switching renderers, the next draw starts a fresh cache
+void releaseTileChunks()
+{
+   for (int i = 0; i < tilechunk_count; i++) {
+      if (tilechunks[i].tex) {
+         SDL_DestroyTexture(tilechunks[i].tex);
+      }
+      free(tilechunks[i].pixels);
+   }
+   free(tilechunks);
+   tilechunks = 0;
+   tilechunk_count = 0;
+}
+
+void bakeTileChunk(world *wd, tilechunk *c, int screen)
+{
+   int screens_w = wd->tilemap.width / (field_w_tiles);
+   int xs = (screen % screens_w) * (field_w_tiles);
+   int ys = (screen / screens_w) * (field_h_tiles);
+
+   SDL_Texture *target = 0;
+   Uint8 r, g, b, a;
+   if (soft.on) {
+      memset(c->pixels, 0, field_w * field_h * sizeof(Uint32));
+   } else {
+      flushSprites();
+      target = SDL_GetRenderTarget(ren);
+      SDL_GetRenderDrawColor(ren, &r, &g, &b, &a);
+      SDL_SetRenderTarget(ren, c->tex);
+      SDL_SetRenderDrawColor(ren, 0, 0, 0, 0);
+      SDL_RenderClear(ren);
+   }
+
+   SDL_Rect src;
+   SDL_Rect dst;
+   src.w = dst.w = src.h = dst.h = tile_size;
+
+   for (int y = 0; y < field_h_tiles; y++) {
+      for (int x = 0; x < field_w_tiles; x++) {
+         int ind = wd->tilemap.data[(xs + x) + (ys + y) * wd->tilemap.width];
+         if (ind && wd->tilemap.tex.tex) {
+            ind -= 1;
+            dst.x = x * tile_size;
+            dst.y = y * tile_size;
+            src.x = wd->tilemap.tex.rect.x + (ind % wd->tilemap.tex_pitch) * tile_size;
+            src.y = wd->tilemap.tex.rect.y + (ind / wd->tilemap.tex_pitch) * tile_size;
+            if (soft.on) {
+               for (int row = 0; row < tile_size; row++) {
+                  memcpy(c->pixels + (dst.y + row) * field_w + dst.x, soft.atlas + (src.y + row) * soft.atlas_w + src.x, tile_size * sizeof(Uint32));
+               }
+            } else {
+               SDL_RenderCopy(ren, wd->tilemap.tex.tex, &src, &dst);
+            }
+         }
+      }
+   }
+
+   if (!soft.on) {
+      SDL_SetRenderTarget(ren, target);
+      SDL_SetRenderDrawColor(ren, r, g, b, a);
+   }
+   c->screen = screen;
+   c->loads = wd->loads;
+   tilechunk_bakes++;
+}
+
+// the baked screen, baking it over the least recently drawn chunk if it
+// isn't in the cache
+tilechunk* getTileChunk(world *wd, int screen)
+{
+   if (!tilechunks) {
+      // the view can straddle 4 screens of each room it shows. with --stream
+      // that's the live room and every neighbour at once, and a budget under
+      // that would rebake chunks every frame
+      int needed = 4 * (stream_rooms?ROOM_CONNECTION_MAX + 1:1);
+      tilechunk_count = max(tilechunk_budget, needed);
+      tilechunks = (tilechunk*)calloc(tilechunk_count, sizeof(tilechunk));
+      invalidateTileChunks();
+   }
+   tilechunk *oldest = tilechunks;
+   for (int i = 0; i < tilechunk_count; i++) {
+      tilechunk *c = tilechunks + i;
+      if (c->screen == screen && c->loads == wd->loads) {
+         c->used = ++tilechunk_clock;
+         return c;
+      }
+      if (c->used < oldest->used) {
+         oldest = c;
+      }
+   }
+   if (soft.on) {
+      if (!oldest->pixels) {
+         oldest->pixels = (Uint32*)malloc(field_w * field_h * sizeof(Uint32));
+      }
+   } else if (!oldest->tex) {
+      oldest->tex = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, field_w, field_h);
+      SDL_SetTextureBlendMode(oldest->tex, SDL_BLENDMODE_BLEND);
+   }
+   bakeTileChunk(wd, oldest, screen);
+   oldest->used = ++tilechunk_clock;
+   return oldest;
+}
+
+void drawTilemap(world *wd)
+{
+   Uint64 prof_start = profBegin();
+   tilelist_s *tl = &wd->tilelist;
+   if (tl->loads != wd->loads || tl->camera.x != wd->camera.view.x || tl->camera.y != wd->camera.view.y) {
+      buildTileList(wd, wd->camera.view);
+   }
+   for (int i = 0; i < tl->count; i++) {
+      tilechunk *c = getTileChunk(wd, tl->screens[i]);
+      if (soft.on) {
+         softBlit(c->pixels, field_w, 0, 0, field_w, field_h, tl->dst[i].x, tl->dst[i].y, 0);
+      } else {
+         SDL_RenderCopy(ren, c->tex, 0, tl->dst + i);
+      }
+   }
+   profEnd(prof_tilemap, prof_start);
+}
+
+roomrect* roomWalls(roomfile *rf)
+{
+   return (roomrect*)((char*)rf + rf->walls);
+}
+
+roomrect* roomLadders(roomfile *rf)
+{
+   return (roomrect*)((char*)rf + rf->ladders);
+}
+
+roomspawn* roomSpawns(roomfile *rf)
+{
+   return (roomspawn*)((char*)rf + rf->spawns);
+}
+
+char* roomTiles(roomfile *rf)
+{
+   return (char*)rf + rf->tiles;
+}
+
+// the records compileRoom() is collecting
+struct roombuilder {
+   roomrect *walls;
+   roomrect *ladders;
+   roomspawn *spawns;
+   int wall_count, ladder_count, spawn_count;
+   int wall_max, ladder_max, spawn_max;
+};
+
+void addRoomRect(roomrect **items, int *count, int *max_count, int x, int y, int w, int h)
+{
+   if (*count == *max_count) {
+      *max_count = max(*max_count * 2, 64);
+      *items = (roomrect*)realloc(*items, *max_count * sizeof(roomrect));
+   }
+   roomrect r = {x, y, w, h};
+   (*items)[(*count)++] = r;
+}
+
+void addRoomSpawn(roombuilder *rb, int kind, float x, float y)
+{
+   if (rb->spawn_count == rb->spawn_max) {
+      rb->spawn_max = max(rb->spawn_max * 2, 64);
+      rb->spawns = (roomspawn*)realloc(rb->spawns, rb->spawn_max * sizeof(roomspawn));
+   }
+   roomspawn s = {kind, rb->wall_count, x, y};
+   rb->spawns[rb->spawn_count++] = s;
+}
+
+// the room text's layout, into a malloc()ed roomfile. tiles are picked from
+// samples tile images. returns 0 if the text is too broken to make a room of
+roomfile* compileRoom(char *fileblock, int size, int samples)
+{
+   int fp = 0;
+   int dims[4];
+   for (int d = 0; d < 4; d++) {
+      while (fp < size && isspace(fileblock[fp])) {
+         fp++;
+      }
+      dims[d] = atoi(fileblock + fp);
+      while (fp < size && !isspace(fileblock[fp])) {
+         fp++;
+      }
+   }
+   while (fp < size && isspace(fileblock[fp])) {
+      fp++;
+   }
+   int tiles_w = dims[0];
+   int tiles_h = dims[1];
+   int screens_w = dims[2];
+   int screens_h = dims[3];
+   if (tiles_w <= 0 || tiles_h <= 0 || screens_w <= 0 || screens_h <= 0) {
+      return 0;
+   }
+
+   roomfile head = {};
+   head.magic = ROOMFILE_MAGIC;
+   head.version = ROOMFILE_VERSION;
+   head.screens_w = screens_w;
+   head.screens_h = screens_h;
+   head.tile_samples = samples;
+   while (fp < size && fileblock[fp] == '+') {
+      char *fstart = fileblock + fp + 1;
+      int fcount = 0;
+      while (fp < size && !isspace(fileblock[fp])) {
+         fp++;
+         fcount++;
+      }
+      if (head.connection_count < ROOM_CONNECTION_MAX) {
+         fcount = min(fcount, RC_FILE_MAX);
+         strncpy(head.filenames[head.connection_count], fstart, fcount);
+         head.filenames[head.connection_count][fcount - 1] = 0;
+         head.connection_count++;
+      }
+      while (fp < size && isspace(fileblock[fp])) {
+         fp++;
+      }
+   }
+
+   // the tiles are picked as the text is read, so the room looks the same
+   // as it always has
+   tilemap_s tm = {};
+   tm.width = screens_w * (field_w_tiles);
+   tm.height = screens_h * (field_h_tiles);
+   tm.size = tm.width * tm.height;
+   tm.data = (char*)calloc(tm.size, sizeof(char));
+   tm.tex_samplecount = max(samples, 1);
+   tm.rng = screens_w + screens_h;
+
+   int tile_xc = field_w_tiles / tiles_w;
+   int tile_yc = field_h_tiles / tiles_h;
+   int rtw = tile_xc * tile_size;
+   int rth = tile_yc * tile_size;
+   int pitch = tiles_w * screens_w;
+   int maxh = tiles_h * screens_h;
+   int tilecount = pitch * maxh;
+   int i = 0;
+   char *block = (char*)malloc(tilecount);
+   memset(block, ' ', tilecount);
+   while (fp < size && i < tilecount) {
+      char c = fileblock[fp];
+      if (!isspace(c)) {
+         block[i++] = c;
+      }
+      fp++;
+   }
+   roombuilder rb = {};
+   i = 0;
+   int reverse = 0;
+   while (i < tilecount) {
+      switch(block[i]) {
+         case '@':
+            {
+               int x = (i % pitch) * rtw + (0.5*rtw -7);
+               int y = (i / pitch) * rth + (0.5*rth -7);
+               addRoomSpawn(&rb, block[i], x, y);
+            } break;
+         case 's':
+         case 'I':
+         case 'i':
+         case 'B':
+         case 'b':
+         case 'D':
+         case 'd':
+         case 'P':
+         case 'p':
+            {
+               int x = (i % pitch) * tile_xc;
+               int y = (i / pitch) * tile_yc;
+               addRoomSpawn(&rb, block[i], (x + 1) * tile_size, (y + 1) * tile_size);
+            }break;
+         case 'M':
+         case 'O':
+            {
+               int x = (i % pitch) * tile_xc;
+               int y = (i / pitch) * tile_yc;
+               addRoomSpawn(&rb, block[i], (x) * tile_size, (y) * tile_size);
+            }break;
+         case 'l':
+            {
+               int x = i % pitch;
+               int y = i / pitch;
+               int h = 1;
+               while (y + h < maxh) {
+                  char ex = block[x + (y+h)*pitch];
+                  if (ex == 'l') {
+                     block[x + (y+h)*pitch] = '-';
+                  } else if (ex == 'L') {
+                     block[x + (y+h)*pitch] = '#';
+                  } else {
+                     break;
+                  }
+                  h++;
+               }
+               addRoomRect(&rb.ladders, &rb.ladder_count, &rb.ladder_max, x * tile_xc, y * tile_yc, tile_xc, h * tile_yc);
+            } break;
+         case 'L':
+            reverse = 1;
+         case '#':
+            {
+               int rx = i % pitch;
+               int ry = i / pitch;
+               int rw = 1;
+               int rh = 1;
+               while (rx + rw < pitch) {
+                  char ex = block[rx + rw + ry * pitch];
+                  if (ex == '#' || ex == 'L') {
+                     rw += 1;
+                  } else {
+                     break;
+                  }
+               }
+               while (ry + rh < maxh) {
+                  int expand = 1;
+                  for (int x = rx; x < rx + rw; x++) {
+                     char ex = block[x + (ry + rh)*pitch];
+                     if (ex != '#' && ex != 'L') {
+                        expand = 0;
+                        break;
+                     }
+                  }
+                  if (expand) {
+                     rh += 1;
+                  } else {
+                     break;
+                  }
+               }
+               for (int y = ry; y < ry + rh; y++) {
+                  for (int x = rx; x < rx + rw; x++) {
+                     if (block[x + y*pitch] == '#') {
+                        block[x + y*pitch] = ' ';
+                     } else {
+                        block[x + y*pitch] = 'l';
+                     }
+                  }
+               }
+               addRoomRect(&rb.walls, &rb.wall_count, &rb.wall_max, rx * tile_xc, ry * tile_yc, rw * tile_xc, rh * tile_yc);
+               setRandomRectangle(&tm, rx * tile_xc, ry * tile_yc, rw * tile_xc, rh * tile_yc);
+               if (reverse) {
+                  reverse = 0;
+                  i--;
+               }
+            } break;
+         default:
+            if (isdigit(block[i]) && block[i] != '0') {
+               char n = block[i];
+               block[i] = ' ';
+               int v = (n - '0') - 1;
+               int x = i % pitch;
+               int y = i / pitch;
+               if (x == 0) {
+                  int h = 1;
+                  int expand = 1;
+                  while (expand && y + h < maxh) {
+                     char c = block[(y+h)*pitch];
+                     if (c == n) {
+                        block[(y+h)*pitch] = ' ';
+                        h += 1;
+                     } else {
+                        expand = 0;
+                     }
+                  }
+                  head.connections[v] = makeTileAlignedRect(-1, y * tile_yc, 2, h * tile_yc);
+               } else if (y == 0) {
+                  int w = 1;
+                  int expand = 1;
+                  while (expand && x + w < pitch) {
+                     int offset = x + w + (y)*pitch;
+                     char c = block[offset];
+                     if (c == n) {
+                        block[offset] = ' ';
+                        w += 1;
+                     } else {
+                        expand = 0;
+                     }
+                  }
+                  head.connections[v] = makeTileAlignedRect(x * tile_xc, -1, w * tile_xc, 2);
+               } else if (x == pitch-1) {
+                  int h = 1;
+                  int expand = 1;
+                  while (expand && y + h < maxh) {
+                     char c = block[pitch - 1 + (y+h)*pitch];
+                     if (c == n) {
+                        block[pitch - 1 + (y+h)*pitch] = ' ';
+                        h += 1;
+                     } else {
+                        expand = 0;
+                     }
+                  }
+                  head.connections[v] = makeTileAlignedRect((pitch-1) * tile_xc + 1, y * tile_yc, 2, h * tile_yc);
+               } else if (y == maxh-1) {
+                  int w = 1;
+                  int expand = 1;
+                  while (expand && x + w < pitch) {
+                     int offset = x + w + (y)*pitch;
+                     char c = block[offset];
+                     if (c == n) {
+                        block[offset] = ' ';
+                        w += 1;
+                     } else {
+                        expand = 0;
+                     }
+                  }
+                  head.connections[v] = makeTileAlignedRect(x * tile_xc, (maxh - 1) * tile_yc + 1, w * tile_xc, 2);
+               }
+            }
+            break;
+      }
+      i++;
+   }
+   free(block);
+
+   head.wall_count = rb.wall_count;
+   head.ladder_count = rb.ladder_count;
+   head.spawn_count = rb.spawn_count;
+   head.tile_count = tm.size;
+   head.walls = sizeof(roomfile);
+   head.ladders = head.walls + rb.wall_count * sizeof(roomrect);
+   head.spawns = head.ladders + rb.ladder_count * sizeof(roomrect);
+   head.tiles = head.spawns + rb.spawn_count * sizeof(roomspawn);
+   head.size = head.tiles + tm.size;
+   roomfile *rf = (roomfile*)malloc(head.size);
+   *rf = head;
+   memcpy(roomWalls(rf), rb.walls, rb.wall_count * sizeof(roomrect));
+   memcpy(roomLadders(rf), rb.ladders, rb.ladder_count * sizeof(roomrect));
+   memcpy(roomSpawns(rf), rb.spawns, rb.spawn_count * sizeof(roomspawn));
+   memcpy(roomTiles(rf), tm.data, tm.size);
+   free(rb.walls);
+   free(rb.ladders);
+   free(rb.spawns);
+   free(tm.data);
+   return rf;
+}
+
+// whether size bytes of a .room file hold a room this build can read
+int checkRoomFile(roomfile *rf, Uint32 size)
+{
+   if (size < sizeof(roomfile) || rf->magic != ROOMFILE_MAGIC || rf->version != ROOMFILE_VERSION || rf->size != size) {
+      return 0;
+   }
+   if (rf->screens_w <= 0 || rf->screens_h <= 0 || rf->connection_count < 0 || rf->connection_count > ROOM_CONNECTION_MAX) {
+      return 0;
+   }
+   if (rf->wall_count < 0 || rf->ladder_count < 0 || rf->spawn_count < 0) {
+      return 0;
+   }
+   if (rf->tile_count != rf->screens_w * (field_w_tiles) * rf->screens_h * (field_h_tiles)) {
+      return 0;
+   }
+   return rf->walls >= sizeof(roomfile) &&
+      rf->ladders >= rf->walls + rf->wall_count * sizeof(roomrect) &&
+      rf->spawns >= rf->ladders + rf->ladder_count * sizeof(roomrect) &&
+      rf->tiles >= rf->spawns + rf->spawn_count * sizeof(roomspawn) &&
+      rf->tiles + rf->tile_count <= size;
+}
+
+// "startroom.txt" compiles to "startroom.room"
+void compiledRoomName(const char *fname, char *out, int size)
+{
+   strncpy(out, fname, size - 8);
+   out[size - 8] = 0;
+   char *dot = strrchr(out, '.');
+   if (dot) {
+      *dot = 0;
+   }
+   strcat(out, ".room");
+}
+
+char* readRoomText(const char *fname, int *size)
+{
+   // the compiler wants the text nul terminated, so this is the one asset
+   // that's copied out of the pak. it's only read when the .room isn't packed
+   size_t packed;
+   const void *p = findPacked(fname, &packed);
+   if (p) {
+      char *text = (char*)malloc(packed + 1);
+      memcpy(text, p, packed);
+      text[packed] = 0;
+      *size = packed;
+      return text;
+   }
+   // text mode, so rooms saved with windows line endings read the same
+   SDL_RWops *rw = SDL_RWFromFile(fname, "r");
+   if (!rw) {
+      return 0;
+   }
+   *size = SDL_RWsize(rw);
+   char *text = (char*)malloc(*size + 1);
+   *size = SDL_RWread(rw, text, 1, *size);
+   text[*size] = 0;
+   SDL_RWclose(rw);
+   return text;
+}
+
+int openRoom(const char *fname, roommap *m)
+{
+   char bin[RC_FILE_MAX + 8];
+   compiledRoomName(fname, bin, sizeof(bin));
+   // a packed .room is read where it sits in the pak, unless its .txt has
+   // been edited since the pak was built
+   size_t packed;
+   roomfile *prf = (roomfile*)findPacked(bin, &packed);
+   if (prf && checkRoomFile(prf, packed) && !newerThanPak(fname)) {
+      m->room = prf;
+      m->size = packed;
+      m->mapped = rm_packed;
+      return 1;
+   }
+   struct stat ts, bs;
+   int have_text = (stat(fname, &ts) == 0);
+   if (stat(bin, &bs) == 0 && (!have_text || bs.st_mtime >= ts.st_mtime)) {
+#ifdef _WIN32
+      SDL_RWops *rw = SDL_RWFromFile(bin, "rb");
+      if (rw) {
+         void *p = malloc(bs.st_size);
+         size_t got = SDL_RWread(rw, p, 1, bs.st_size);
+         SDL_RWclose(rw);
+         if (got == (size_t)bs.st_size && checkRoomFile((roomfile*)p, bs.st_size)) {
+            m->room = (roomfile*)p;
+            m->size = bs.st_size;
+            m->mapped = rm_heap;
+            return 1;
+         }
+         free(p);
+      }
+#else
+      int fd = open(bin, O_RDONLY);
+      if (fd >= 0) {
+         void *p = mmap(0, bs.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+         close(fd);
+         if (p != MAP_FAILED) {
+            if (checkRoomFile((roomfile*)p, bs.st_size)) {
+               m->room = (roomfile*)p;
+               m->size = bs.st_size;
+               m->mapped = rm_mapped;
+               return 1;
+            }
+            munmap(p, bs.st_size);
+         }
+      }
+#endif
+   }
+   int size;
+   char *text = readRoomText(fname, &size);
+   if (!text) {
+      return 0;
+   }
+   m->room = compileRoom(text, size, tileSamples(tex.wall));
+   m->size = m->room?m->room->size:0;
+   m->mapped = rm_heap;
+   free(text);
+   return m->room != 0;
+}
+
+void closeRoom(roommap *m)
+{
+   if (m->mapped == rm_packed) {
+      m->room = 0;
+      return;
+   }
+#ifndef _WIN32
+   if (m->mapped == rm_mapped) {
+      munmap(m->room, m->size);
+      m->room = 0;
+      return;
+   }
+#endif
+   free(m->room);
+   m->room = 0;
+}
+
+// replaces whatever room the world was in with rf. connection is nonzero
+// when the player walked in from the room named in wd->room.roomname
+void enterRoom(world *wd, roomfile *rf, const char *fname, int connection)
+{
+   // loads are numbered across every world, so a tile chunk baked for one
+   // room is never mistaken for another world's
+   wd->loads = SDL_AtomicAdd(&room_loads, 1) + 1;
+   clearEnemies(wd);
+   clearWalls(wd);
+   resetConnections(wd);
+   for (int c = 0; c < rf->connection_count; c++) {
+      memcpy(wd->room.filenames[c], rf->filenames[c], RC_FILE_MAX);
+      if (connection && strcmp(wd->room.filenames[c], wd->room.roomname) == 0) {
+         connection = c + 1;
+      }
+   }
+   wd->room.connection_count = rf->connection_count;
+   setRoomName(wd, fname);
+
+   initTilemap(wd, rf->screens_w, rf->screens_h, tex.wall);
+
+   wd->camera.bounds.x = 0;
+   wd->camera.bounds.y = 0;
+   wd->camera.bounds.w = (rf->screens_w - 1) * field_w;
+   wd->camera.bounds.h = (rf->screens_h - 1) * field_h;
+
+   wd->room.bounds.x = 0;
+   wd->room.bounds.y = 0;
+   wd->room.bounds.w = (rf->screens_w) * field_w;
+   wd->room.bounds.h = (rf->screens_h) * field_h;
+
+   roomrect *walls = roomWalls(rf);
+   roomspawn *spawns = roomSpawns(rf);
+   int w = 0;
+   for (int s = 0; s < rf->spawn_count; s++) {
+      roomspawn *sp = spawns + s;
+      for (; w < min(sp->walls, rf->wall_count); w++) {
+         createTileAlignedWall(wd, walls[w].x, walls[w].y, walls[w].w, walls[w].h);
+      }
+      switch (sp->kind) {
+         case '@':
+            if (!connection) {
+               wd->p1 = createPlayer(wd, sp->x, sp->y);
+            }
+            break;
+         case 's':
+            createSaucerMob(wd, sp->x, sp->y);
+            break;
+         case 'I':
+         case 'i':
+            createItem(wd, sp->x, sp->y, sp->kind == 'I', 1);
+            break;
+         case 'B':
+         case 'b':
+            createBulletMob(wd, sp->x, sp->y, sp->kind == 'b');
+            break;
+         case 'D':
+         case 'd':
+            createDozer(wd, sp->x, sp->y, sp->kind == 'd');
+            break;
+         case 'P':
+         case 'p':
+            createSpiderMob(wd, sp->x, sp->y, sp->kind == 'p');
+            break;
+         case 'M':
+            startMirv(wd, sp->x, sp->y);
+            break;
+         case 'O':
+            createBoulder(wd, sp->x, sp->y);
+            break;
+      }
+   }
+   for (; w < rf->wall_count; w++) {
+      createTileAlignedWall(wd, walls[w].x, walls[w].y, walls[w].w, walls[w].h);
+   }
+   roomrect *ladders = roomLadders(rf);
+   for (int l = 0; l < rf->ladder_count; l++) {
+      createTileAlignedLadder(wd, ladders[l].x, ladders[l].y, ladders[l].w, ladders[l].h);
+   }
+
+   if (rf->tile_samples == wd->tilemap.tex_samplecount) {
+      memcpy(wd->tilemap.data, roomTiles(rf), wd->tilemap.size);
+   } else {
+      for (w = 0; w < rf->wall_count; w++) {
+         setRandomRectangle(&wd->tilemap, walls[w].x, walls[w].y, walls[w].w, walls[w].h);
+      }
+   }
+
+   memcpy(wd->room.connections, rf->connections, sizeof(rf->connections));
+   if (connection && wd->room.connections[connection - 1].w > 0) {
+      wd->p1.position.x = wd->room.connections[connection - 1].x + wd->room.transition_offset.x;
+      wd->p1.position.y = wd->room.connections[connection - 1].y + wd->room.transition_offset.y;
+   }
+   buildWallGrid(wd);
+   buildLadderIndex(wd);
+}
+
+roomfile* findCachedRoom(roomcache_s *rc, const char *fname)
+{
+   for (int i = 0; i < rc->count; i++) {
+      if (strcmp(rc->rooms[i].name, fname) == 0) {
+         rc->rooms[i].used = ++rc->clock;
+         rc->hits++;
+         return rc->rooms[i].map.room;
+      }
+   }
+   rc->misses++;
+   return 0;
+}
+
+void evictCachedRoom(roomcache_s *rc, int i)
+{
+   rc->bytes -= rc->rooms[i].map.size;
+   closeRoom(&rc->rooms[i].map);
+   rc->rooms[i] = rc->rooms[--rc->count];
+}
+
+// the cache takes m over, unless the room is too big for it or the cache
+// is off, and returns 0 then
+int cacheRoom(roomcache_s *rc, const char *fname, roommap *m)
+{
+   if (m->size > room_cache_budget || strlen(fname) >= RC_FILE_MAX) {
+      return 0;
+   }
+   while (rc->count == ROOM_CACHE_MAX || rc->bytes + m->size > room_cache_budget) {
+      int oldest = 0;
+      for (int i = 1; i < rc->count; i++) {
+         if (rc->rooms[i].used < rc->rooms[oldest].used) {
+            oldest = i;
+         }
+      }
+      evictCachedRoom(rc, oldest);
+   }
+   cachedroom *cr = rc->rooms + rc->count++;
+   strcpy(cr->name, fname);
+   cr->map = *m;
+   cr->used = ++rc->clock;
+   rc->bytes += m->size;
+   return 1;
+}
+
+void releaseRoomCache(roomcache_s *rc)
+{
+   while (rc->count) {
+      evictCachedRoom(rc, rc->count - 1);
+   }
+}
+
+// a thread that opens the rooms next to the one a world just entered while
+// the game goes on. loadLevel() only takes rooms it has finished, it never
+// waits on one, so a step can't stall on the disk
+enum prefetchstates {
+   pf_empty,
+   pf_queued,
+   pf_loading,
+   pf_ready
+};
+
+struct prefetchslot {
+   char name[RC_FILE_MAX];
+   roommap map;
+   int state;
+   // set when the room stops being wanted while the thread has it
+   int cancel;
+};
+
+struct roomloader {
+   SDL_Thread *thread;
+   SDL_mutex *lock;
+   SDL_cond *wake;
+   prefetchslot slots[ROOM_CONNECTION_MAX];
+   int quit;
+   // rooms loadLevel() needed that weren't cached, and whether the loader
+   // had them ready
+   int hits;
+   int misses;
+};
+
+int roomLoaderThread(void *data)
+{
+   roomloader *rl = (roomloader*)data;
+   SDL_LockMutex(rl->lock);
+   while (!rl->quit) {
+      prefetchslot *ps = 0;
+      for (int i = 0; i < ROOM_CONNECTION_MAX && !ps; i++) {
+         if (rl->slots[i].state == pf_queued) {
+            ps = rl->slots + i;
+         }
+      }
+      if (!ps) {
+         SDL_CondWait(rl->wake, rl->lock);
+         continue;
+      }
+      ps->state = pf_loading;
+      char name[RC_FILE_MAX];
+      memcpy(name, ps->name, RC_FILE_MAX);
+      SDL_UnlockMutex(rl->lock);
+      roommap m;
+      int opened = openRoom(name, &m);
+      SDL_LockMutex(rl->lock);
+      if (opened && !ps->cancel) {
+         ps->map = m;
+         ps->state = pf_ready;
+      } else {
+         if (opened) {
+            closeRoom(&m);
+         }
+         ps->state = pf_empty;
+      }
+      ps->cancel = 0;
+   }
+   SDL_UnlockMutex(rl->lock);
+   return 0;
+}
+
+roomloader* createRoomLoader()
+{
+   roomloader *rl = (roomloader*)calloc(1, sizeof(roomloader));
+   rl->lock = SDL_CreateMutex();
+   rl->wake = SDL_CreateCond();
+   rl->thread = SDL_CreateThread(roomLoaderThread, "rooms", rl);
+   return rl;
+}
+
+void destroyRoomLoader(roomloader *rl)
+{
+   SDL_LockMutex(rl->lock);
+   rl->quit = 1;
+   SDL_CondSignal(rl->wake);
+   SDL_UnlockMutex(rl->lock);
+   SDL_WaitThread(rl->thread, 0);
+   for (int i = 0; i < ROOM_CONNECTION_MAX; i++) {
+      if (rl->slots[i].state == pf_ready) {
+         closeRoom(&rl->slots[i].map);
+      }
+   }
+   SDL_DestroyCond(rl->wake);
+   SDL_DestroyMutex(rl->lock);
+   free(rl);
+}
+
+// hands over the room if the loader has it ready. a room it hasn't
+// finished is given up on, the caller loads it itself. connected is
+// whether the room was reached through a connection, the only way one gets
+// queued, so only those count as a miss when the loader doesn't have it
+int takePrefetchedRoom(roomloader *rl, const char *fname, roommap *out, int connected)
+{
+   int found = 0;
+   SDL_LockMutex(rl->lock);
+   for (int i = 0; i < ROOM_CONNECTION_MAX; i++) {
+      prefetchslot *ps = rl->slots + i;
+      if (ps->state == pf_empty || strcmp(ps->name, fname) != 0) {
+         continue;
+      }
+      if (ps->state == pf_ready) {
+         *out = ps->map;
+         ps->state = pf_empty;
+         found = 1;
+      } else if (ps->state == pf_queued) {
+         ps->state = pf_empty;
+      } else {
+         ps->cancel = 1;
+      }
+   }
+   if (found) {
+      rl->hits++;
+   } else if (connected) {
+      rl->misses++;
+   }
+   SDL_UnlockMutex(rl->lock);
+   return found;
+}
+
+// queues the rooms wd's room connects to that it doesn't have cached, and
+// drops anything the loader had for rooms that aren't next door any more
+void prefetchNeighbours(world *wd)
+{
+   roomloader *rl = wd->loader;
+   SDL_LockMutex(rl->lock);
+   for (int i = 0; i < ROOM_CONNECTION_MAX; i++) {
+      prefetchslot *ps = rl->slots + i;
+      int wanted = 0;
+      for (int c = 0; c < wd->room.connection_count; c++) {
+         wanted |= (strcmp(ps->name, wd->room.filenames[c]) == 0);
+      }
+      if (ps->state == pf_empty) {
+         continue;
+      }
+      if (wanted) {
+         ps->cancel = 0;
+         continue;
+      }
+      if (ps->state == pf_ready) {
+         closeRoom(&ps->map);
+         ps->state = pf_empty;
+      } else if (ps->state == pf_queued) {
+         ps->state = pf_empty;
+      } else {
+         ps->cancel = 1;
+      }
+   }
+   int queued = 0;
+   for (int c = 0; c < wd->room.connection_count; c++) {
+      const char *name = wd->room.filenames[c];
+      int have = 0;
+      for (int i = 0; i < wd->rooms.count; i++) {
+         have |= (strcmp(wd->rooms.rooms[i].name, name) == 0);
+      }
+      for (int i = 0; i < ROOM_CONNECTION_MAX; i++) {
+         have |= (rl->slots[i].state != pf_empty && !rl->slots[i].cancel && strcmp(rl->slots[i].name, name) == 0);
+      }
+      for (int i = 0; i < ROOM_CONNECTION_MAX && !have; i++) {
+         prefetchslot *ps = rl->slots + i;
+         if (ps->state == pf_empty) {
+            memcpy(ps->name, name, RC_FILE_MAX);
+            ps->state = pf_queued;
+            queued = have = 1;
+         }
+      }
+   }
+   if (queued) {
+      SDL_CondSignal(rl->wake);
+   }
+   SDL_UnlockMutex(rl->lock);
+}
+
+// rooms come out of the world's cache when they can, then from its room
+// loader, then off the disk. a room the cache can't keep comes back in temp
+// as well, for the caller to closeRoom() when it's done with it. a room's
+// text edited while the game is running shows up the next time it starts
+roomfile* fetchRoom(world *wd, const char *fname, roommap *temp, int connected)
+{
+   temp->room = 0;
+   roomfile *rf = findCachedRoom(&wd->rooms, fname);
+   if (rf) {
+      return rf;
+   }
+   roommap m;
+   if ((wd->loader && takePrefetchedRoom(wd->loader, fname, &m, connected)) || openRoom(fname, &m)) {
+      if (!cacheRoom(&wd->rooms, fname, &m)) {
+         *temp = m;
+      }
+      return m.room;
+   }
+   return 0;
+}
+
+void loadLevel(world *wd, const char * fname, int connection)
+{
+   roommap temp;
+   roomfile *rf = fetchRoom(wd, fname, &temp, connection != 0);
+   if (!rf) {
+      return;
+   }
+   enterRoom(wd, rf, fname, connection);
+   if (temp.room) {
+      closeRoom(&temp);
+   }
+   if (wd->loader) {
+      prefetchNeighbours(wd);
+   }
+}
+
+void printRoomStats(world *wd)
+{
+   printf("%d rooms entered, %d from the cache", wd->rooms.hits + wd->rooms.misses, wd->rooms.hits);
+   if (wd->loader) {
+      printf(", %d prefetched, %d prefetch misses", wd->loader->hits, wd->loader->misses);
+   }
+   printf("\n");
+}
+
+#define ROOM_LIST_MAX 64
+
+// every room reachable from startroom.txt through the '+' connections
+int listRooms(world *wd, char rooms[ROOM_LIST_MAX][RC_FILE_MAX])
+{
+   int roomcount = 1;
+   strncpy(rooms[0], "startroom.txt", RC_FILE_MAX);
+   for (int r = 0; r < roomcount; r++) {
+      loadLevel(wd, rooms[r], 0);
+      for (int c = 0; c < wd->room.connection_count; c++) {
+         int seen = 0;
+         for (int k = 0; k < roomcount; k++) {
+            seen |= (strcmp(rooms[k], wd->room.filenames[c]) == 0);
+         }
+         if (!seen && roomcount < ROOM_LIST_MAX) {
+            strncpy(rooms[roomcount++], wd->room.filenames[c], RC_FILE_MAX);
+         }
+      }
+   }
+   return roomcount;
+}
+
+// the offline half of the .room format: compiles every room reachable from
+// startroom.txt to a .room file beside its .txt. tiles are picked for the
+// tileset in wall.gif, the one the game draws with
+int compileRooms()
+{
+   int samples = 1;
+   SDL_Surface *wall = IMG_Load("wall.gif");
+   if (wall) {
+      samples = (wall->w / tile_size) * (wall->h / tile_size);
+      SDL_FreeSurface(wall);
+   }
+   char rooms[ROOM_LIST_MAX][RC_FILE_MAX];
+   int roomcount = 1;
+   int failures = 0;
+   strncpy(rooms[0], "startroom.txt", RC_FILE_MAX);
+   for (int r = 0; r < roomcount; r++) {
+      int size;
+      char *text = readRoomText(rooms[r], &size);
+      roomfile *rf = text?compileRoom(text, size, samples):0;
+      free(text);
+      char bin[RC_FILE_MAX + 8];
+      compiledRoomName(rooms[r], bin, sizeof(bin));
+      FILE *out = rf?fopen(bin, "wb"):0;
+      if (!out || fwrite(rf, 1, rf->size, out) != rf->size) {
+         printf("%s: couldn't compile\n", rooms[r]);
+         failures++;
+      } else {
+         printf("%-16s -> %-16s %3d walls %3d ladders %3d spawns %6u bytes\n", rooms[r], bin, rf->wall_count, rf->ladder_count, rf->spawn_count, rf->size);
+         for (int c = 0; c < rf->connection_count; c++) {
+            int seen = 0;
+            for (int k = 0; k < roomcount; k++) {
+               seen |= (strcmp(rooms[k], rf->filenames[c]) == 0);
+            }
+            if (!seen && roomcount < ROOM_LIST_MAX) {
+               strncpy(rooms[roomcount++], rf->filenames[c], RC_FILE_MAX);
+            }
+         }
+      }
+      if (out) {
+         fclose(out);
+      }
+      free(rf);
+   }
+   return failures;
+}
+
+// the offline half of assets.pak: packs the pictures, sounds and music the
+// game loads at start, and every room reachable from startroom.txt along
+// with its .room if there is one. run it after --compile-rooms
+#define PAK_FILES_MAX (64 + 2 * ROOM_LIST_MAX)
+
+struct packfile {
+   char name[PAK_NAME_MAX];
+   char *data;
+   size_t size;
+};
+
+int comparePackFile(const void *a, const void *b)
+{
+   return strcmp(((const packfile*)a)->name, ((const packfile*)b)->name);
+}
+
+int addPackFile(packfile *files, int *count, const char *name)
+{
+   if (*count >= PAK_FILES_MAX || strlen(name) >= PAK_NAME_MAX) {
+      printf("%s: can't pack\n", name);
+      return 0;
+   }
+   SDL_RWops *rw = SDL_RWFromFile(name, "rb");
+   if (!rw) {
+      // the game gets by without it, so the pak can too
+      printf("%s: not found, left out\n", name);
+      return 1;
+   }
+   packfile *pf = files + (*count)++;
+   strcpy(pf->name, name);
+   pf->size = SDL_RWsize(rw);
+   pf->data = (char*)malloc(pf->size);
+   pf->size = SDL_RWread(rw, pf->data, 1, pf->size);
+   SDL_RWclose(rw);
+   return 1;
+}
+
+int packAssets()
+{
+   static packfile files[PAK_FILES_MAX];
+   int count = 0;
+   int failures = 0;
+   for (unsigned i = 0; i < sizeof(atlas_files) / sizeof(atlas_files[0]); i++) {
+      failures += !addPackFile(files, &count, atlas_files[i].file);
+   }
+   for (unsigned i = 0; i < sizeof(sound_files) / sizeof(sound_files[0]); i++) {
+      failures += !addPackFile(files, &count, sound_files[i].file);
+   }
+   for (unsigned i = 0; i < sizeof(music_files) / sizeof(music_files[0]); i++) {
+      failures += !addPackFile(files, &count, music_files[i].file);
+   }
+
+   char rooms[ROOM_LIST_MAX][RC_FILE_MAX];
+   int roomcount = 1;
+   strncpy(rooms[0], "startroom.txt", RC_FILE_MAX);
+   for (int r = 0; r < roomcount; r++) {
+      int size;
+      char *text = readRoomText(rooms[r], &size);
+      roomfile *rf = text?compileRoom(text, size, 1):0;
+      if (!rf || count >= PAK_FILES_MAX) {
+         printf("%s: couldn't pack\n", rooms[r]);
+         failures++;
+         free(text);
+         free(rf);
+         continue;
+      }
+      // packed as read in text mode, the same bytes the game would compile
+      packfile *pf = files + count++;
+      strcpy(pf->name, rooms[r]);
+      pf->data = text;
+      pf->size = size;
+      char bin[RC_FILE_MAX + 8];
+      compiledRoomName(rooms[r], bin, sizeof(bin));
+      struct stat bs;
+      if (stat(bin, &bs) == 0) {
+         failures += !addPackFile(files, &count, bin);
+      }
+      for (int c = 0; c < rf->connection_count; c++) {
+         int seen = 0;
+         for (int k = 0; k < roomcount; k++) {
+            seen |= (strcmp(rooms[k], rf->filenames[c]) == 0);
+         }
+         if (!seen && roomcount < ROOM_LIST_MAX) {
+            strncpy(rooms[roomcount++], rf->filenames[c], RC_FILE_MAX);
+         }
+      }
+      free(rf);
+   }
+
+   qsort(files, count, sizeof(packfile), comparePackFile);
+   pakheader head = {PAK_MAGIC, PAK_VERSION, 0, (Uint32)count};
+   pakentry *entries = (pakentry*)calloc(count, sizeof(pakentry));
+   size_t at = sizeof(pakheader) + count * sizeof(pakentry);
+   for (int i = 0; i < count; i++) {
+      at = (at + PAK_ALIGN - 1) / PAK_ALIGN * PAK_ALIGN;
+      strcpy(entries[i].name, files[i].name);
+      entries[i].offset = at;
+      entries[i].size = files[i].size;
+      at += files[i].size;
+   }
+   head.size = at;
+
+   FILE *out = fopen(PAK_FILE, "wb");
+   if (!out) {
+      printf("%s: couldn't write\n", PAK_FILE);
+      failures++;
+   } else {
+      static const char zeros[PAK_ALIGN] = {};
+      fwrite(&head, sizeof(head), 1, out);
+      fwrite(entries, sizeof(pakentry), count, out);
+      for (int i = 0; i < count; i++) {
+         fwrite(zeros, 1, entries[i].offset - ftell(out), out);
+         if (fwrite(files[i].data, 1, files[i].size, out) != files[i].size) {
+            failures++;
+         }
+      }
+      fclose(out);
+      printf("%s: %d files, %u bytes\n", PAK_FILE, count, head.size);
+   }
+   for (int i = 0; i < count; i++) {
+      free(files[i].data);
+   }
+   free(entries);
+   return failures;
+}
+
+// sweeps random rects through every room reachable from startroom.txt and
+// checks that the batched slab test agrees with the scalar one
+int physicsSelfTest(world *wd)
+{
+   char rooms[ROOM_LIST_MAX][RC_FILE_MAX];
+   int roomcount = listRooms(wd, rooms);
+   int mismatches = 0;
+   long sweeps = 0;
+   for (int r = 0; r < roomcount; r++) {
+      loadLevel(wd, rooms[r], 0);
+      for (int k = 0; k < 100000; k++) {
+         rect mr = makeRect(rand() % (int)wd->room.bounds.w, rand() % (int)wd->room.bounds.h, 4 + rand() % 12, 4 + rand() % 12);
+         v2 mrv = makev2((rand() % 2001 - 1000) / 200.f, (rand() % 2001 - 1000) / 200.f);
+         if (rand() % 4 == 0) {
+            mrv.x = 0;
+         }
+         if (rand() % 4 == 0) {
+            mrv.y = 0;
+         }
+         v2 sn, vn;
+         float st, vt;
+         wall_simd = 0;
+         int sres = clipMovingRectWithWallGrid(wd, &mr, &mrv, &sn, &st);
+         wall_simd = 1;
+         int vres = clipMovingRectWithWallGrid(wd, &mr, &mrv, &vn, &vt);
+         sweeps++;
+         if (sres != vres || st != vt || sn.x != vn.x || sn.y != vn.y) {
+            mismatches++;
+            printf("%s: (%f, %f, %f, %f) v (%f, %f): scalar %d t %f n (%f, %f), batched %d t %f n (%f, %f)\n",
+                  rooms[r], mr.x, mr.y, mr.w, mr.h, mrv.x, mrv.y, sres, st, sn.x, sn.y, vres, vt, vn.x, vn.y);
+         }
+      }
+   }
+#ifdef WALL_LANES
+   printf("%d rooms, %ld sweeps, %d lanes, %d mismatches\n", roomcount, sweeps, WALL_LANES, mismatches);
+#else
+   printf("%d rooms, %ld sweeps, no simd support compiled in\n", roomcount, sweeps);
+#endif
+   return mismatches;
+}
+
+// runs the same random sweeps and falling bodies through the float and the
+// fixed point getMotionWalled() and reports speed and how far they drift apart
+void physicsBench(world *wd)
+{
+   char rooms[ROOM_LIST_MAX][RC_FILE_MAX];
+   int roomcount = listRooms(wd, rooms);
+   const int sweepcount = 50000;
+   const int bodycount = 200;
+   const int ticks = 1000;
+   rect *bounds = (rect*)malloc(sweepcount * sizeof(rect));
+   v2 *vels = (v2*)malloc(sweepcount * sizeof(v2));
+   v2 *fl_out = (v2*)malloc(sweepcount * sizeof(v2));
+   v2 *fx_out = (v2*)malloc(sweepcount * sizeof(v2));
+   v2 *fl_vel = (v2*)malloc(sweepcount * sizeof(v2));
+   v2 *fx_vel = (v2*)malloc(sweepcount * sizeof(v2));
+   printf("%-16s %12s %12s %10s %12s %10s %12s\n", "room", "float ns", "fixed ns", "diffs", "max disp", "clipdiffs", "body drift");
+   for (int r = 0; r < roomcount; r++) {
+      loadLevel(wd, rooms[r], 0);
+      for (int k = 0; k < sweepcount; k++) {
+         bounds[k] = makeRect(rand() % (int)wd->room.bounds.w, rand() % (int)wd->room.bounds.h, 4 + rand() % 12, 4 + rand() % 12);
+         vels[k] = makev2((rand() % 2001 - 1000) / 200.f, (rand() % 2001 - 1000) / 200.f);
+      }
+      Uint64 start = SDL_GetPerformanceCounter();
+      for (int k = 0; k < sweepcount; k++) {
+         getMotionWalledFloat(wd, bounds + k, vels + k, fl_vel + k, fl_out + k);
+      }
+      Uint64 mid = SDL_GetPerformanceCounter();
+      for (int k = 0; k < sweepcount; k++) {
+         getMotionWalledFixed(wd, bounds + k, vels + k, fx_vel + k, fx_out + k);
+      }
+      Uint64 end = SDL_GetPerformanceCounter();
+
+      int diffs = 0;
+      int clipdiffs = 0;
+      float maxdisp = 0;
+      for (int k = 0; k < sweepcount; k++) {
+         v2 d = fl_out[k] - fx_out[k];
+         float len = lenv2(&d);
+         diffs += (len > 0);
+         maxdisp = fmax(maxdisp, len);
+         clipdiffs += (fl_vel[k].x != fx_vel[k].x || fl_vel[k].y != fx_vel[k].y);
+      }
+
+      // player sized bodies falling and sliding around the room for a while
+      float drift = 0;
+      for (int b = 0; b < bodycount; b++) {
+         v2 flpos = makev2(rand() % (int)wd->room.bounds.w, rand() % (int)wd->room.bounds.h);
+         rect start_bounds = makeRect(flpos.x - 7, flpos.y - 7, 14, 14);
+         if (rectIntersectsWalls(wd, &start_bounds)) {
+            continue;
+         }
+         v2 fxpos = flpos;
+         v2 flv = makev2((rand() % 301 - 150) / 100.f, 0);
+         v2 fxv = flv;
+         for (int t = 0; t < ticks; t++) {
+            v2 disp;
+            rect flb = makeRect(flpos.x - 7, flpos.y - 7, 14, 14);
+            rect fxb = makeRect(fxpos.x - 7, fxpos.y - 7, 14, 14);
+            flv.y += 0.09;
+            fxv.y += 0.09;
+            getMotionWalledFloat(wd, &flb, &flv, &flv, &disp);
+            flpos = flpos + disp;
+            getMotionWalledFixed(wd, &fxb, &fxv, &fxv, &disp);
+            fxpos = fxpos + disp;
+         }
+         v2 d = flpos - fxpos;
+         drift = fmax(drift, lenv2(&d));
+      }
+
+      double freq = SDL_GetPerformanceFrequency();
+      printf("%-16s %12.1f %12.1f %10d %12f %10d %12f\n", rooms[r],
+            (mid - start) * 1e9 / freq / sweepcount, (end - mid) * 1e9 / freq / sweepcount,
+            diffs, maxdisp, clipdiffs, drift);
+   }
+   free(bounds);
+   free(vels);
+   free(fl_out);
+   free(fx_out);
+   free(fl_vel);
+   free(fx_vel);
+}
+
+#define print_pool_stats(name, p) \
+   printf("%-10s %6d %6d %6d %10d %10d %8d\n", name, p.count, p.capacity(), p.high_water, p.adds, p.erases, p.rejected)
+
+// per tick cost of the pool against the plain array + swap erase it replaced,
+// on a rocket barrage: move everything, drop what left the room, refill
+void poolBench(world *wd)
+{
+   const int cap = 512;
+   const int ticks = 4000;
+   // the best of several rounds each, taken in turns, so a noisy machine
+   // doesn't pick the winner
+   const int rounds = 7;
+   struct oldrockets {
+      mirvrocket data[cap];
+      int count;
+   };
+   oldrockets *old = (oldrockets*)calloc(1, sizeof(oldrockets));
+   pool<mirvrocket, cap> rockets(cap);
+   float roomh = 480;
+
+   double freq = SDL_GetPerformanceFrequency();
+   double best_old = 0;
+   double best_pool = 0;
+   for (int r = 0; r < rounds; r++) {
+      srand(1);
+      Uint64 start = SDL_GetPerformanceCounter();
+      for (int t = 0; t < ticks; t++) {
+         while (old->count < cap) {
+            mirvrocket *mr = old->data + old->count++;
+            mr->position = makev2(rand() % 640, rand() % 480);
+            mr->velocity = makev2(0, 1 + rand() % 4);
+         }
+         for (int i = 0; i < old->count;) {
+            mirvrocket *mr = old->data + i;
+            mr->position = mr->position + mr->velocity;
+            if (mr->position.y > roomh) {
+               old->data[i] = old->data[old->count - 1];
+               old->count--;
+               continue;
+            }
+            i++;
+         }
+      }
+      Uint64 mid = SDL_GetPerformanceCounter();
+      srand(1);
+      for (int t = 0; t < ticks; t++) {
+         while (!rockets.full()) {
+            mirvrocket *mr = rockets.add();
+            mr->position = makev2(rand() % 640, rand() % 480);
+            mr->velocity = makev2(0, 1 + rand() % 4);
+         }
+         for (int i = 0; i < rockets.count;) {
+            mirvrocket *mr = rockets.at(i);
+            mr->position = mr->position + mr->velocity;
+            if (mr->position.y > roomh) {
+               rockets.erase(i);
+               continue;
+            }
+            i++;
+         }
+      }
+      Uint64 end = SDL_GetPerformanceCounter();
+      double t_old = (mid - start) * 1e9 / freq / ticks;
+      double t_pool = (end - mid) * 1e9 / freq / ticks;
+      best_old = (r == 0 || t_old < best_old)?t_old:best_old;
+      best_pool = (r == 0 || t_pool < best_pool)?t_pool:best_pool;
+   }
+   printf("array + swap erase: %8.1f ns/tick\n", best_old);
+   printf("pool:               %8.1f ns/tick\n", best_pool);
+   rockets.release();
+   free(old);
+
+   char rooms[ROOM_LIST_MAX][RC_FILE_MAX];
+   listRooms(wd, rooms);
+   printf("\n%-10s %6s %6s %6s %10s %10s %8s\n", "pool", "count", "cap", "high", "adds", "erases", "rejected");
+   print_pool_stats("rockets", rockets);
+   print_pool_stats("walls", wd->walls);
+   print_pool_stats("ladders", wd->ladders);
+   print_pool_stats("dozers", wd->dozers);
+   print_pool_stats("bullets", wd->bullets);
+   print_pool_stats("saucers", wd->saucers);
+   print_pool_stats("spiders", wd->spiders);
+   print_pool_stats("items", wd->items);
+}
+
+// the dozer layout before the hot fields were split out, kept for --mob-bench
+struct olddozer {
+   asprite spr;
+   int hitpoints;
+   v2 position;
+   v2 velocity;
+   float frame;
+   int flip;
+   int flipping;
+   int state_timer;
+   int active;
+   int shot_hit;
+};
+
+// tickDozers() as it was, minus dying, shots and hurting the player,
+// none of which happen in the bench
+void tickOldDozers(world *wd, olddozer *dozers, int count)
+{
+   for (int i = 0; i < count; i++) {
+      olddozer *dz = dozers + i;
+      rect dozerbounds = makeRect(dz->position.x - 4, dz->position.y - 6, 8, 12);
+      dz->active = rectOnScreen(wd, &dozerbounds);
+      if (dz->active) {
+         if (dz->flipping) {
+            dz->state_timer -= 1;
+            if (dz->state_timer < 1) {
+               dz->flipping = 0;
+               dz->flip = !dz->flip;
+            }
+            dz->velocity.x = fapproach(dz->velocity.x, 0, 0.1);
+            v2 displacement;
+            getMotionWalled(wd, &dozerbounds, &dz->velocity, &dz->velocity, &displacement);
+            dz->position = dz->position + displacement;
+         } else {
+            rect edgesensor;
+            if (dz->flip) {
+               dz->velocity.x = fapproach(dz->velocity.x, -1, 0.1);
+               edgesensor = makeRect(dz->position.x - 2 - 16, dz->position.y, 4, 9);
+            } else {
+               dz->velocity.x = fapproach(dz->velocity.x, 1, 0.1);
+               edgesensor = makeRect(dz->position.x - 2 + 16, dz->position.y, 4, 9);
+            }
+            v2 displacement;
+            getMotionWalled(wd, &dozerbounds, &dz->velocity, &dz->velocity, &displacement);
+            dz->position = dz->position + displacement;
+            if (fabs(displacement.x) <= PHYS_EPSILON || !rectIntersectsWalls(wd, &edgesensor)) {
+               dz->state_timer = 50;
+               dz->flipping = 1;
+            }
+         }
+         p_shot *bullet = wd->pshots.atSafe(dz->shot_hit - 1);
+         if (bullet) {
+            bullet->position.x = -1000;
+         }
+         rectsOverlap(&dozerbounds, getPlayerBounds(wd, &wd->p1));
+      }
+   }
+}
+
+// a made up one screen room of shelves for the mob benches
+void buildShelves(world *wd)
+{
+   clearWalls(wd);
+   clearEnemies(wd);
+   wd->pshots.clear();
+   wd->camera.position = makev2(0, 0);
+   srand(1);
+   for (int y = 32; y < field_h; y += 32) {
+      for (int x = 0; x < field_w;) {
+         int w = 48 + rand() % 64;
+         createWall(wd, x, y, w, 8);
+         x += w + 24;
+      }
+   }
+   buildWallGrid(wd);
+}
+
+// ticks per second with 10000 dozers patrolling shelves in a made up room,
+// through the old inline layout and through the split one
+void mobBench(world *wd)
+{
+   const int count = 10000;
+   const int ticks = 40;
+   const int rounds = 5;
+   buildShelves(wd);
+   wd->p1.position = makev2(-1000, -1000);
+   wd->p1.w = wd->p1.h = 14;
+   wd->p1.last_bounds_frame = -1;
+
+   olddozer *old = (olddozer*)calloc(count, sizeof(olddozer));
+   wd->dozers.limit = 0;
+   wd->dozers.reserve(count);
+   for (int k = 0; k < count; k++) {
+      v2 p = makev2(rand() % field_w, 32 * (1 + rand() % (field_h / 32 - 1)) - 6.5);
+      int flip = rand() % 2;
+      createDozer(wd, p.x, p.y, flip);
+      old[k].spr = wd->dozers.cold[k].spr;
+      old[k].position = p;
+      old[k].flip = flip;
+      old[k].hitpoints = 2;
+   }
+
+   // one thread, this is about the layout. the two take turns a round at a
+   // time and each keeps its best round, so a noisy machine doesn't pick
+   // the winner
+   threadpool *jobs = wd->jobs;
+   wd->jobs = 0;
+   Uint64 best_old = 0;
+   Uint64 best_split = 0;
+   for (int r = 0; r < rounds; r++) {
+      Uint64 t0 = SDL_GetPerformanceCounter();
+      for (int t = 0; t < ticks; t++) {
+         tickOldDozers(wd, old, count);
+      }
+      Uint64 t1 = SDL_GetPerformanceCounter();
+      for (int t = 0; t < ticks; t++) {
+         tickEnemies(wd);
+      }
+      Uint64 t2 = SDL_GetPerformanceCounter();
+      best_old = (r == 0 || t1 - t0 < best_old)?t1 - t0:best_old;
+      best_split = (r == 0 || t2 - t1 < best_split)?t2 - t1:best_split;
+   }
+   wd->jobs = jobs;
+
+   int mismatches = 0;
+   for (int k = 0; k < count; k++) {
+      mismatches += (old[k].position.x != wd->dozers.position[k].x || old[k].position.y != wd->dozers.position[k].y);
+   }
+   double freq = SDL_GetPerformanceFrequency();
+   printf("%d dozers, %d walls, best of %d rounds of %d ticks\n", count, wd->walls.count, rounds, ticks);
+   printf("inline sprites: %8.1f ticks/s (%zu bytes per dozer)\n", ticks * freq / best_old, sizeof(olddozer));
+   printf("split columns:  %8.1f ticks/s (%.2fx)\n", ticks * freq / best_split, (double)best_old / best_split);
+   printf("%d position mismatches\n", mismatches);
+   free(old);
+}
+
+unsigned int hashBytes(unsigned int h, const void *data, int size)
+{
+   const unsigned char *p = (const unsigned char*)data;
+   for (int i = 0; i < size; i++) {
+      h = (h ^ p[i]) * 16777619u;
+   }
+   return h;
+}
+
+#define hash_column(mobs, field) hashBytes(h, mobs.field, mobs.count * sizeof(*mobs.field))
+
+// everything tickEnemies() can change, boiled down to one number
+unsigned int enemyChecksum(world *wd)
+{
+   unsigned int h = 2166136261u;
+   h = hash_column(wd->dozers, position);
+   h = hash_column(wd->dozers, velocity);
+   h = hash_column(wd->dozers, flags);
+   h = hash_column(wd->bullets, position);
+   h = hash_column(wd->bullets, velocity);
+   h = hash_column(wd->saucers, position);
+   h = hash_column(wd->spiders, position);
+   h = hash_column(wd->spiders, flags);
+   for (int i = 0; i < wd->slasers.count; i++) {
+      h = hashBytes(h, &wd->slasers.at(i)->position, sizeof(v2));
+   }
+   for (int i = 0; i < wd->mirvrs.count; i++) {
+      h = hashBytes(h, &wd->mirvrs.at(i)->position, sizeof(v2));
+   }
+   for (int i = 0; i < wd->effects.count; i++) {
+      h = hashBytes(h, &wd->effects.at(i)->position, sizeof(v2));
+   }
+   for (int i = 0; i < wd->items.count; i++) {
+      h = hashBytes(h, &wd->items.at(i)->position, sizeof(v2));
+   }
+   h = hashBytes(h, &wd->p1.velocity, sizeof(v2));
+   h = hashBytes(h, &wd->p1.hitpoints, sizeof(int));
+   h = hashBytes(h, &wd->rng, sizeof(wd->rng));
+   return h;
+}
+
+// ticks per second for tickEnemies() on a screen packed with every kind of
+// mob and a rocket barrage, with the player stood in the middle of it, on 1
+// to 8 threads. every run has to end up exactly where the 1 thread one did
+int enemyBench()
+{
+   const int count = 2500;
+   const int ticks = 300;
+   const int threadcounts[] = {1, 2, 4, 8};
+   unsigned int serial = 0;
+   double serial_rate = 0;
+   int mismatches = 0;
+   printf("%d of each mob, %d ticks\n", count, ticks);
+   for (int c = 0; c < 4; c++) {
+      world *wd = createWorld(1);
+      wd->room.bounds = makeRect(0, 0, field_w, field_h);
+      buildShelves(wd);
+      wd->p1 = createPlayer(wd, field_w / 2, field_h / 2 - 4);
+      wd->dozers.limit = wd->bullets.limit = wd->saucers.limit = wd->spiders.limit = 0;
+      for (int k = 0; k < count; k++) {
+         float shelf = 32 * (1 + rand() % (field_h / 32 - 1));
+         createDozer(wd, rand() % field_w, shelf - 6.5, rand() % 2);
+         createBulletMob(wd, rand() % field_w, rand() % field_h, rand() % 2);
+         createSaucerMob(wd, rand() % field_w, rand() % field_h);
+         createSpiderMob(wd, rand() % field_w, shelf - 6.5, rand() % 2);
+      }
+      for (int k = 0; k < 256; k++) {
+         fireMirvRocket(wd, rand() % field_w, -(rand() % 200), 0, 1, 3);
+      }
+      wd->jobs = createThreadPool(threadcounts[c]);
+
+      Uint64 start = SDL_GetPerformanceCounter();
+      for (int t = 0; t < ticks; t++) {
+         tickEnemies(wd);
+         wd->frame++;
+      }
+      Uint64 end = SDL_GetPerformanceCounter();
+
+      double rate = ticks * (double)SDL_GetPerformanceFrequency() / (end - start);
+      unsigned int sum = enemyChecksum(wd);
+      if (c == 0) {
+         serial = sum;
+         serial_rate = rate;
+      }
+      mismatches += (sum != serial);
+      printf("%d threads: %8.1f ticks/s, %5.2fx, %d jobs, checksum %08x%s\n", threadcounts[c], rate, rate / serial_rate,
+            wd->enemyjob_count, sum, (sum == serial)?"":" MISMATCH");
+      destroyThreadPool(wd->jobs);
+      destroyWorld(wd);
+   }
+   return mismatches;
+}
+
+void reproject_screen(int w, int h)
+{
+   float scale = fmin((float)w / field_w, (float)h / field_h);
+   projection.w = field_w * scale;
+   projection.h = field_h * scale;
+   projection.x = (w - projection.w)/2;
+   projection.y = (h - projection.h)/2;
+}
+
+void setupControls(int forcekeys)
+{
+   if (!joy) {
+      joy = SDL_JoystickOpen(0);
+   }
+   clearBindings();
+   if (joy && !forcekeys) {
+      con.left = bindAxis(0, -1);
+      con.right = bindAxis(0, 1);
+      con.up = bindAxis(1, -1);
+      con.down = bindAxis(1, 1);
+      // NOTE(afox): xbox controller buttons are different on windows for some reason?
+#ifdef _WIN32
+      con.jump = bindButton(10);
+      con.fire = bindButton(12);
+      con.reset = bindButton(5);
+#else
+      con.jump = bindButton(0);
+      con.fire = bindButton(2);
+      con.reset = bindButton(8);
+#endif
+   } else {
+      con.left = bindKey(SDLK_LEFT);
+      con.right = bindKey(SDLK_RIGHT);
+      con.up = bindKey(SDLK_UP);
+      con.down = bindKey(SDLK_DOWN);
+      con.jump = bindKey(SDLK_d);
+      con.fire = bindKey(SDLK_f);
+      con.reset = bindKey(SDLK_BACKSPACE);
+   }
+
+}
+
+void stagePlayer(void *data, int)
+{
+   world *wd = (world*)data;
+   if (!wd->neighbour) {
+      tickPlayer(wd, &wd->p1);
+   }
+}
+
+void stageShots(void *data, int)
+{
+   world *wd = (world*)data;
+   stepPshots(wd);
+   resolvePshotHits(wd);
+}
+
+void stageEnemies(void *data, int)
+{
+   tickEnemies((world*)data);
+}
+
+void stageMirv(void *data, int)
+{
+   tickMirv((world*)data);
+}
+
+void stageAnimateEnemies(void *data, int)
+{
+   animateEnemies((world*)data);
+}
+
+void stageAnimatePlayer(void *data, int)
+{
+   world *wd = (world*)data;
+   // a neighbour's player is a copy, the live room animates the real one
+   if (!wd->neighbour) {
+      animatePlayer(&wd->p1);
+   }
+}
+
+void stageMoveShots(void *data, int)
+{
+   // shots have always moved twice a step, this half used to live in drawPshots(wd)
+   movePshots((world*)data);
+}
+
+void stageEffects(void *data, int)
+{
+   tickEffects((world*)data);
+}
+
+// built for where the step leaves the camera, which is where render()
+// draws from unless it's between steps
+void stageTileList(void *data, int)
+{
+   world *wd = (world*)data;
+   buildTileList(wd, wd->camera.position);
+}
+
+void stageRoomChange(void *data, int)
+{
+   world *wd = (world*)data;
+   int lload = 0;
+   if (!wd->neighbour && !pointInRect(&wd->room.bounds, &wd->p1.position)) {
+      for (int i = 0; i < ROOM_CONNECTION_MAX; i++) {
+         if (pointInRect(&wd->room.connections[i], &wd->p1.position)) {
+            lload = i + 1;
+            wd->room.transition_offset.x = wd->p1.position.x - wd->room.connections[i].x;
+            wd->room.transition_offset.y = wd->p1.position.y - wd->room.connections[i].y;
+            break;
+         }
+      }
+   }
+   if (lload > 0 && wd->streamed) {
+      wd->exit_connection = lload;
+   } else if (lload > 0) {
+      char buf[RC_FILE_MAX];
+      strncpy(buf, wd->room.filenames[lload - 1], RC_FILE_MAX);
+      //printf("going to %s\n", buf);
+      loadLevel(wd, buf, 1);
+   }
+   wd->frame++;
+}
+
+// the stages of a step and what each one waits for. they're added in the
+// order they always ran in, which is how they run with no workers. with
+// workers, enemy animation overlaps Mirv and what comes after him, and
+// the tile list for render() is built while everything else ticks
+taskgraph* buildFrameGraph(world *wd)
+{
+   taskgraph *g = (taskgraph*)calloc(1, sizeof(taskgraph));
+   int player = addTask(g, "player", stagePlayer, wd);
+   int shots = addTask(g, "shots", stageShots, wd);
+   addTaskDep(g, shots, player);
+   int enemies = addTask(g, "enemies", stageEnemies, wd);
+   addTaskDep(g, enemies, shots);
+   int mirv = addTask(g, "mirv", stageMirv, wd);
+   addTaskDep(g, mirv, enemies);
+   int animate_enemies = addTask(g, "animate enemies", stageAnimateEnemies, wd);
+   addTaskDep(g, animate_enemies, enemies);
+   int animate_player = addTask(g, "animate player", stageAnimatePlayer, wd);
+   addTaskDep(g, animate_player, mirv);
+   int move_shots = addTask(g, "move shots", stageMoveShots, wd);
+   addTaskDep(g, move_shots, mirv);
+   int effects = addTask(g, "effects", stageEffects, wd);
+   addTaskDep(g, effects, mirv);
+   // nothing to draw with no display
+   int tiles = -1;
+   if (!headless) {
+      tiles = addTask(g, "tile list", stageTileList, wd);
+      addTaskDep(g, tiles, player);
+   }
+   int room = addTask(g, "room change", stageRoomChange, wd);
+   addTaskDep(g, room, animate_enemies);
+   addTaskDep(g, room, animate_player);
+   addTaskDep(g, room, move_shots);
+   addTaskDep(g, room, effects);
+   if (tiles >= 0) {
+      addTaskDep(g, room, tiles);
+   }
+   return g;
+}
+
+// keeps where everything render() interpolates was before the step
+void savePrevious(world *wd)
+{
+   wd->prev_loads = wd->loads;
+   wd->camera.prev_position = wd->camera.position;
+   wd->p1.prev_position = wd->p1.position;
+   wd->mirv.prev_position = wd->mirv.position;
+   for (int i = 0; i < wd->boulders.count; i++) {
+      boulderboss *bb = wd->boulders.at(i);
+      rect *b = getBoulderBounds(wd, bb);
+      if (b) {
+         bb->prev_position = makev2(b->x, b->y);
+      }
+   }
+   memcpy(wd->dozers.prev_position, wd->dozers.position, wd->dozers.count * sizeof(v2));
+   memcpy(wd->bullets.prev_position, wd->bullets.position, wd->bullets.count * sizeof(v2));
+   memcpy(wd->saucers.prev_position, wd->saucers.position, wd->saucers.count * sizeof(v2));
+   memcpy(wd->spiders.prev_position, wd->spiders.position, wd->spiders.count * sizeof(v2));
+   for (int i = 0; i < wd->slasers.count; i++) {
+      wd->slasers.at(i)->prev_position = wd->slasers.at(i)->position;
+   }
+   for (int i = 0; i < wd->items.count; i++) {
+      wd->items.at(i)->prev_position = wd->items.at(i)->position;
+   }
+   for (int i = 0; i < wd->mirvrs.count; i++) {
+      wd->mirvrs.at(i)->prev_position = wd->mirvrs.at(i)->position;
+   }
+   for (int i = 0; i < wd->pshots.count; i++) {
+      wd->pshots.at(i)->prev_position = wd->pshots.at(i)->position;
+   }
+   for (int i = 0; i < wd->effects.count; i++) {
+      wd->effects.at(i)->prev_position = wd->effects.at(i)->position;
+   }
+}
+
+// one fixed step of the game. no drawing happens in here, everything the
+// renderer needs is left in the game state for render() to read
+void simulate(world *wd)
+{
+   savePrevious(wd);
+   if (!wd->pipeline) {
+      wd->pipeline = buildFrameGraph(wd);
+   }
+   runTaskGraph(wd->jobs, wd->pipeline);
+}
+
+// streamed worlds (--stream). the room the player is in and every room it
+// connects to are all loaded, each in a world of its own, placed side by
+// side the way their connections line up. walking through a connection
+// makes the room next door the live one instead of loading it, and the room
+// behind keeps going. the rooms next door step at a fraction of the rate,
+// so the cost goes with how many rooms are next door, not how big the
+// whole map is. a room the camera can see steps every step, so the player
+// and the player's shots get to it in time
+#define STREAM_ROOM_MAX (ROOM_CONNECTION_MAX + 1)
+// the rooms next door out of sight step once every this many steps, taking turns
+#define STREAM_NEIGHBOUR_RATE 4
+
+struct streamroom {
+   world *wd;
+   // the room's top left in the live room's coordinates
+   v2 origin;
+   // which of the room's connections leads back to the live room, 0 if none
+   // does and there's no way to line the two up
+   int back;
+   // the camera could see it as of the last step
+   int seen;
+};
+
+struct worldstream {
+   // rooms[0] is the room the player is in
+   streamroom rooms[STREAM_ROOM_MAX];
+   int count;
+   int steps;
+   // the live room's loads when the rooms next door were last placed. a
+   // reset or a death reloads it out from under the stream
+   int arranged;
+   // which live shot each of a neighbour's copies was made from
+   handle *shots_live;
+   handle *shots_copied;
+   int shots_max;
+};
+
+worldstream *stream;
+
+// loads the live room's neighbours that aren't loaded, drops the rooms that
+// aren't neighbours any more and lines them all up against the live room
+void arrangeStream(worldstream *st)
+{
+   world *wd = st->rooms[0].wd;
+   wd->streamed = 1;
+   wd->neighbour = 0;
+   st->rooms[0].origin = makev2(0, 0);
+   st->rooms[0].back = 0;
+   for (int r = 1; r < st->count;) {
+      int wanted = 0;
+      for (int c = 0; c < wd->room.connection_count; c++) {
+         wanted |= (strcmp(wd->room.filenames[c], st->rooms[r].wd->room.roomname) == 0);
+      }
+      if (!wanted) {
+         destroyWorld(st->rooms[r].wd);
+         st->rooms[r] = st->rooms[--st->count];
+         continue;
+      }
+      r++;
+   }
+   for (int c = 0; c < wd->room.connection_count; c++) {
+      const char *name = wd->room.filenames[c];
+      int have = (strcmp(name, wd->room.roomname) == 0);
+      for (int r = 1; r < st->count; r++) {
+         have |= (strcmp(name, st->rooms[r].wd->room.roomname) == 0);
+      }
+      if (have || st->count == STREAM_ROOM_MAX) {
+         continue;
+      }
+      roommap temp;
+      roomfile *rf = fetchRoom(wd, name, &temp, 1);
+      if (!rf) {
+         continue;
+      }
+      world *n = createWorld(worldRand(wd));
+      n->jobs = wd->jobs;
+      n->streamed = 1;
+      n->neighbour = 1;
+      enterRoom(n, rf, name, 0);
+      if (temp.room) {
+         closeRoom(&temp);
+      }
+      st->rooms[st->count].wd = n;
+      st->count++;
+   }
+
+   // a player walking from connection c into a room comes out at its
+   // connection back, at the same offset, so that offset is the room's too
+   rect view = wd->room.bounds;
+   for (int r = 1; r < st->count; r++) {
+      streamroom *sr = st->rooms + r;
+      sr->back = 0;
+      for (int c = 0; c < wd->room.connection_count && !sr->back; c++) {
+         if (strcmp(wd->room.filenames[c], sr->wd->room.roomname) != 0) {
+            continue;
+         }
+         for (int b = 0; b < sr->wd->room.connection_count; b++) {
+            if (strcmp(sr->wd->room.filenames[b], wd->room.roomname) == 0 && sr->wd->room.connections[b].w > 0) {
+               sr->back = b + 1;
+               sr->origin.x = wd->room.connections[c].x - sr->wd->room.connections[b].x;
+               sr->origin.y = wd->room.connections[c].y - sr->wd->room.connections[b].y;
+            }
+         }
+      }
+      if (sr->back) {
+         float x0 = fmin(view.x, sr->origin.x);
+         float y0 = fmin(view.y, sr->origin.y);
+         view.w = fmax(view.x + view.w, sr->origin.x + sr->wd->room.bounds.w) - x0;
+         view.h = fmax(view.y + view.h, sr->origin.y + sr->wd->room.bounds.h) - y0;
+         view.x = x0;
+         view.y = y0;
+      }
+   }
+   // the camera can go anywhere over the rooms, not just the live one
+   wd->camera.bounds = makeRect(view.x, view.y, view.w - field_w, view.h - field_h);
+   st->arranged = wd->loads;
 }
 
-struct {
-   char *data;
-   SDL_Texture *tex;
-   int width, height;
-   int size;
-   int tex_pitch;
-   int tex_samplecount;
-} tilemap;
+worldstream* createStream(world *wd)
+{
+   worldstream *st = (worldstream*)calloc(1, sizeof(worldstream));
+   st->rooms[0].wd = wd;
+   st->count = 1;
+   arrangeStream(st);
+   return st;
+}
 
-void initTilemap(int screens_w, int screens_h, SDL_Texture *tex)
+// the player went through the live room's connection c into a room next
+// door. that room takes the player over and becomes the live one
+void crossStream(worldstream *st, int c)
 {
-   free(tilemap.data);
+   world *wd = st->rooms[0].wd;
+   int r = 1;
+   while (r < st->count && strcmp(st->rooms[r].wd->room.roomname, wd->room.filenames[c - 1]) != 0) {
+      r++;
+   }
+   if (r == st->count || !st->rooms[r].back) {
+      // nowhere to put the room, so it's loaded the old way
+      char buf[RC_FILE_MAX];
+      strncpy(buf, wd->room.filenames[c - 1], RC_FILE_MAX);
+      loadLevel(wd, buf, 1);
+      arrangeStream(st);
+      return;
+   }
+   world *n = st->rooms[r].wd;
+   int b = st->rooms[r].back;
+   // the same place the player would have come out had the room been loaded
+   v2 to = makev2(n->room.connections[b - 1].x + wd->room.transition_offset.x, n->room.connections[b - 1].y + wd->room.transition_offset.y);
+   v2 shift = to - wd->p1.position;
+   n->p1 = wd->p1;
+   n->p1.position = to;
+   n->p1.prev_position = wd->p1.prev_position + shift;
+   n->p1.last_bounds_frame = n->frame - 1;
+   n->room.transition_offset = wd->room.transition_offset;
+   n->camera.position = wd->camera.position + shift;
+   n->camera.prev_position = wd->camera.prev_position + shift;
+   // the cache and the room loader follow the player
+   roomcache_s rooms = n->rooms;
+   n->rooms = wd->rooms;
+   wd->rooms = rooms;
+   n->loader = wd->loader;
+   wd->loader = 0;
+   wd->neighbour = 1;
+   streamroom live = st->rooms[0];
+   st->rooms[0] = st->rooms[r];
+   st->rooms[r] = live;
+   arrangeStream(st);
+   if (n->loader) {
+      prefetchNeighbours(n);
+   }
+}
 
-   tilemap.width  = screens_w * field_w_tiles;
-   tilemap.height = screens_h * field_h_tiles;
-   tilemap.size = tilemap.width * tilemap.height;
-   tilemap.data = (char*)calloc(tilemap.size, sizeof(char));
+// steps a room next door against the live one. it gets a copy of the
+// player and of the player's shots, in its own coordinates, and whatever
+// it does to them goes back to the live room: hurting or pushing the
+// player, pickups, and shots spent on its enemies
+void stepNeighbour(worldstream *st, streamroom *sr)
+{
+   world *wd = st->rooms[0].wd;
+   world *n = sr->wd;
+   n->p1 = wd->p1;
+   n->p1.position = wd->p1.position - sr->origin;
+   n->p1.prev_position = wd->p1.prev_position - sr->origin;
+   n->p1.last_bounds_frame = n->frame - 1;
+   n->camera.position = wd->camera.position - sr->origin;
+   // the copies go in a step behind, the step moves them up to where the
+   // live ones are before they're checked against the enemies
+   if (st->shots_max < wd->pshots.count) {
+      st->shots_max = wd->pshots.count;
+      st->shots_live = (handle*)realloc(st->shots_live, st->shots_max * sizeof(handle));
+      st->shots_copied = (handle*)realloc(st->shots_copied, st->shots_max * sizeof(handle));
+   }
+   int shot_count = 0;
+   n->pshots.clear();
+   for (int i = 0; i < wd->pshots.count; i++) {
+      if (wd->pshots.at(i)->spent) {
+         continue;
+      }
+      p_shot *shot = n->pshots.add();
+      if (!shot) {
+         break;
+      }
+      *shot = *wd->pshots.at(i);
+      shot->position = shot->position - sr->origin - shot->velocity;
+      shot->prev_position = shot->position;
+      shot->last_bounds_frame = n->frame - 1;
+      st->shots_live[shot_count] = wd->pshots.handleAt(i);
+      st->shots_copied[shot_count] = n->pshots.handleAt(n->pshots.count - 1);
+      shot_count++;
+   }
+   simulate(n);
+   for (int k = 0; k < shot_count; k++) {
+      p_shot *copy = n->pshots.get(st->shots_copied[k]);
+      p_shot *shot = wd->pshots.get(st->shots_live[k]);
+      if (copy && shot && copy->spent) {
+         spendShot(shot);
+      }
+   }
+   n->pshots.clear();
+   // rooms that don't line up with the live one can't reach the player
+   if (sr->back) {
+      v2 prev = wd->p1.prev_position;
+      wd->p1 = n->p1;
+      wd->p1.position = n->p1.position + sr->origin;
+      wd->p1.prev_position = prev;
+      wd->p1.last_bounds_frame = wd->frame - 1;
+   }
+}
 
-   srand(screens_w + screens_h);
-   int tw, th;
-   tilemap.tex = tex;
-   SDL_QueryTexture(tex, 0, 0, &tw, &th);
-   tilemap.tex_pitch = tw / tile_size;
-   tilemap.tex_samplecount = tilemap.tex_pitch * (th / tile_size);
+// one step of the streamed world, returns the room the player is in after it
+world* simulateStream(worldstream *st)
+{
+   world *wd = st->rooms[0].wd;
+   wd->exit_connection = 0;
+   simulate(wd);
+   st->steps++;
+   for (int r = 1; r < st->count; r++) {
+      streamroom *sr = st->rooms + r;
+      rect view = makeRect(wd->camera.position.x - sr->origin.x, wd->camera.position.y - sr->origin.y, field_w, field_h);
+      sr->seen = sr->back && rectsOverlap(&view, &sr->wd->room.bounds);
+      if (sr->seen || (st->steps + r) % STREAM_NEIGHBOUR_RATE == 0) {
+         stepNeighbour(st, sr);
+      }
+   }
+   if (wd->exit_connection) {
+      crossStream(st, wd->exit_connection);
+   } else if (wd->loads != st->arranged) {
+      arrangeStream(st);
+   }
+   return st->rooms[0].wd;
 }
 
-void setRandomTile(int x, int y)
+// the live room isn't the stream's, whoever made the stream still has it
+void destroyStream(worldstream *st)
 {
-   assert(x >= 0 && x < tilemap.width && y >= 0 && y < tilemap.height);
-   tilemap.data[x + y * tilemap.width] = (rand() % tilemap.tex_samplecount) + 1;
+   for (int r = 1; r < st->count; r++) {
+      destroyWorld(st->rooms[r].wd);
+   }
+   free(st->shots_live);
+   free(st->shots_copied);
+   free(st);
 }
 
-void setRandomRectangle(int x, int y, int w, int h)
+// draws the frame's recorded ops, a band of rows per task
+void rasterizeSoftOps(threadpool *tp)
 {
-   int xs = max(x, 0);
-   int ys = max(y, 0);
-   int xm = min(tilemap.width,  x + w);
-   int ym = min(tilemap.height, y + h);
-   for (y = ys; y < ym; y++) {
-      for (x = xs; x < xm; x++) {
-         setRandomTile(x, y);
+   Uint64 prof_start = profBegin();
+   int bands = soft.bands;
+   parallelFor(tp, bands, rasterSoftBand, &bands);
+   soft.op_count = 0;
+   profEnd(prof_raster, prof_start);
+}
+
+// the rooms next door to a streamed world's, seen through the live room's
+// camera. rooms the camera can't see aren't drawn at all
+void drawNeighbours(worldstream *st)
+{
+   world *wd = st->rooms[0].wd;
+   for (int r = 1; r < st->count; r++) {
+      streamroom *sr = st->rooms + r;
+      world *n = sr->wd;
+      if (!sr->back) {
+         continue;
+      }
+      n->camera.view = wd->camera.view - sr->origin;
+      rect seen = makeRect(n->camera.view.x, n->camera.view.y, field_w, field_h);
+      if (!rectsOverlap(&seen, &n->room.bounds)) {
+         continue;
       }
+      // rooms that were out of sight step too seldom to draw between steps
+      n->alpha = sr->seen?wd->alpha:1;
+      drawTilemap(n);
+      drawLadders(n);
+      drawEnemies(n);
+      drawMirv(n);
+      drawPshots(n);
+      drawEffects(n);
    }
 }
 
-void drawTilemap()
+// draws the current game state into pixelbuffer and doesn't change any of it
+void drawScene(world *wd)
 {
-   if (tilemap.data) {
-      int ofsx = floor(camera.position.x);
-      int ofsy = floor(camera.position.y);
-      int tstartx = ofsx / tile_size;
-      int tstarty = ofsy / tile_size;
-      int xs = max(tstartx, 0);
-      int ys = max(tstarty, 0);
-      int xm = min(tilemap.width,  tstartx + field_w);
-      int ym = min(tilemap.height, tstarty + field_h);
+   v2 view = interp(wd, wd->camera.prev_position, wd->camera.position);
+   wd->camera.view = makev2(floor(view.x), floor(view.y));
+   if (!soft.on) {
+      SDL_SetRenderTarget(ren, pixelbuffer);
+   }
+   clearScreen(25, 25, 25);
+   SDL_SetRenderDrawColor(ren, 0, 255, 255, 255);
+   //debugDrawWalls(wd, ren);
+   if (stream && stream->rooms[0].wd == wd) {
+      drawNeighbours(stream);
+   }
+   drawTilemap(wd);
+   drawLadders(wd);
+   drawEnemies(wd);
+   drawMirv(wd);
+   drawPlayer(wd, &wd->p1);
+   drawPshots(wd);
+   drawEffects(wd);
+   //drawConnections(wd);
+   //drawing goes here
+   if (prof.overlay) {
+      drawProfOverlay();
+   }
+   flushSprites();
+   if (soft.on) {
+      rasterizeSoftOps(wd->jobs);
+      SDL_UpdateTexture(pixelbuffer, 0, soft.pixels, field_w * sizeof(Uint32));
+   }
+}
 
-      SDL_Rect src;
-      SDL_Rect dst;
-      src.w = dst.w = src.h = dst.h = tile_size;
+void render(world *wd)
+{
+   drawScene(wd);
+   SDL_SetRenderTarget(ren, 0);
+   SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
+   SDL_RenderClear(ren);
+   SDL_RenderCopy(ren, pixelbuffer, 0, &projection);
+   Uint64 prof_start = profBegin();
+   SDL_RenderPresent(ren);
+   profEnd(prof_present, prof_start);
+}
 
-      for (int y = ys; y < ym; y++) {
-         for (int x = xs; x < xm; x++) {
-            int ind = tilemap.data[x + y * tilemap.width];
-            if (ind) {
-               ind -= 1;
-               dst.x = x * tile_size - ofsx;
-               dst.y = y * tile_size - ofsy;
-               src.x = (ind % tilemap.tex_pitch) * tile_size;
-               src.y = (ind / tilemap.tex_pitch) * tile_size;
-               SDL_RenderCopy(ren, tilemap.tex, &src, &dst);
-            }
+// time walking back and forth between startroom.txt and the first room it
+// connects to, with the room cache off and then on
+int roomBench()
+{
+   const int trips = 2000;
+   size_t budget = room_cache_budget;
+   double freq = SDL_GetPerformanceFrequency();
+   for (int cached = 0; cached < 2; cached++) {
+      room_cache_budget = cached?budget:0;
+      world *wd = createWorld(1);
+      loadLevel(wd, "startroom.txt", 0);
+      char rooms[2][RC_FILE_MAX];
+      strncpy(rooms[0], "startroom.txt", RC_FILE_MAX);
+      strncpy(rooms[1], wd->room.filenames[0], RC_FILE_MAX);
+      Uint64 worst = 0;
+      Uint64 start = SDL_GetPerformanceCounter();
+      for (int t = 0; t < trips; t++) {
+         Uint64 load_start = SDL_GetPerformanceCounter();
+         loadLevel(wd, rooms[(t + 1) % 2], 1);
+         Uint64 took = SDL_GetPerformanceCounter() - load_start;
+         if (took > worst) {
+            worst = took;
          }
       }
+      Uint64 end = SDL_GetPerformanceCounter();
+      printf("%-10s %8.1f us per room, %8.1f us worst, %d hits, %d misses\n", cached?"cached:":"uncached:",
+            (end - start) * 1e6 / freq / trips, worst * 1e6 / freq, wd->rooms.hits, wd->rooms.misses);
+      destroyWorld(wd);
    }
+   room_cache_budget = budget;
+   return 0;
 }
 
-void loadLevel(const char * fname, int connection)
+// frames per second drawing the bossroom.txt scene into the pixelbuffer,
+// through SDL's software renderer and through ours, on a software
+// renderer of our own so it's the same whatever the window got. then ours
+// again in 2 to 8 bands, which has to come out exactly like 1 band did
+int renderBench()
 {
-   SDL_RWops *rw = SDL_RWFromFile(fname, "r");
-   if (connection != 0) {
-      int debug = 5;
+   const int frames = 2000;
+   SDL_Surface *target = SDL_CreateRGBSurfaceWithFormat(0, field_w, field_h, 32, SDL_PIXELFORMAT_RGBA32);
+   ren = SDL_CreateSoftwareRenderer(target);
+   releaseTileChunks();
+   loadAtlas();
+   pixelbuffer = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, field_w, field_h);
+
+   world *wd = createWorld(1);
+   setupControls(1);
+   startControlFrame();
+   loadLevel(wd, "bossroom.txt", 0);
+   for (int t = 0; t < 300; t++) {
+      simulate(wd);
    }
-   if (rw) {
-      clearEnemies();
-      clearWalls();
-      room.connection_count = 0;
-      unsigned int size = SDL_RWsize(rw);
-      char * fileblock = (char*)malloc(size);
-      SDL_RWread(rw, fileblock, 1, size);
-      SDL_RWclose(rw);
-      int fp = 0;
 
-      int tiles_w;
-      int tiles_h;
-      int screens_w;
-      int screens_h;
+   double freq = SDL_GetPerformanceFrequency();
+   soft.on = 0;
+   Uint64 start = SDL_GetPerformanceCounter();
+   for (int f = 0; f < frames; f++) {
+      drawScene(wd);
+      SDL_RenderFlush(ren);
+   }
+   double sdl_rate = frames * freq / (SDL_GetPerformanceCounter() - start);
+   Uint32 *sdl_pixels = (Uint32*)malloc(field_w * field_h * sizeof(Uint32));
+   SDL_RenderReadPixels(ren, 0, SDL_PIXELFORMAT_RGBA32, sdl_pixels, field_w * sizeof(Uint32));
+
+   releaseTileChunks();
+   soft.on = 1;
+   SDL_DestroyTexture(pixelbuffer);
+   pixelbuffer = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, field_w, field_h);
+   start = SDL_GetPerformanceCounter();
+   for (int f = 0; f < frames; f++) {
+      drawScene(wd);
+   }
+   double soft_rate = frames * freq / (SDL_GetPerformanceCounter() - start);
 
-      while(isspace(fileblock[fp])) {
-         fp++;
+   int differ = 0;
+   for (int i = 0; i < field_w * field_h; i++) {
+      differ += (sdl_pixels[i] != soft.pixels[i]);
+   }
+   printf("bossroom.txt, %d frames\n", frames);
+   printf("sdl software: %8.1f frames/s\n", sdl_rate);
+   printf("in house:     %8.1f frames/s, %5.2fx\n", soft_rate, soft_rate / sdl_rate);
+   printf("%d of %d pixels differ\n", differ, field_w * field_h);
+
+   const int bandcounts[] = {2, 4, 8};
+   int mismatches = 0;
+   memcpy(sdl_pixels, soft.pixels, field_w * field_h * sizeof(Uint32));
+   for (int c = 0; c < 3; c++) {
+      soft.bands = bandcounts[c];
+      wd->jobs = createThreadPool(soft.bands);
+      memset(soft.pixels, 0, sizeof(soft.pixels));
+      start = SDL_GetPerformanceCounter();
+      for (int f = 0; f < frames; f++) {
+         drawScene(wd);
       }
+      double rate = frames * freq / (SDL_GetPerformanceCounter() - start);
+      int same = memcmp(sdl_pixels, soft.pixels, sizeof(soft.pixels)) == 0;
+      mismatches += !same;
+      printf("%d bands:      %8.1f frames/s, %5.2fx%s\n", soft.bands, rate, rate / soft_rate, same?"":" MISMATCH");
+      destroyThreadPool(wd->jobs);
+      wd->jobs = 0;
+   }
+   soft.bands = 1;
+   free(sdl_pixels);
+   destroyWorld(wd);
+   return mismatches;
+}
 
-      tiles_w = atoi(fileblock + fp);
-      while(!isspace(fileblock[fp])) {
-         fp++;
+// most rooms have no @ and are only ever walked into, so a headless run
+// starting in one puts the player just inside its first connection, as if
+// they'd come through it. 0 if the room has no way in either
+int spawnAtConnection(world *wd)
+{
+   if (wd->p1.alive) {
+      return 1;
+   }
+   for (int c = 0; c < wd->room.connection_count; c++) {
+      rect *r = wd->room.connections + c;
+      if (r->w <= 0) {
+         continue;
       }
-      while(isspace(fileblock[fp])) {
-         fp++;
+      float x = r->x + r->w * 0.5;
+      float y = r->y + r->h * 0.5;
+      if (r->x < 0) {
+         x = r->x + r->w + tile_size;
+      } else if (r->y < 0) {
+         y = r->y + r->h + tile_size;
+      } else if (r->x + r->w > wd->room.bounds.w) {
+         x = r->x - tile_size;
+      } else {
+         y = r->y - tile_size;
       }
+      wd->p1 = createPlayer(wd, x, y);
+      return 1;
+   }
+   return 0;
+}
 
-      tiles_h = atoi(fileblock + fp);
-      while(!isspace(fileblock[fp])) {
-         fp++;
-      }
-      while(isspace(fileblock[fp])) {
-         fp++;
-      }
+// a player standing still only crosschecks landing on the floor, so a
+// headless --physics-crosscheck run walks them back and forth, jumping and
+// climbing now and then
+void walkCrosscheckPlayer(int tick)
+{
+   const int keys[] = {SDLK_LEFT, SDLK_RIGHT, SDLK_UP, SDLK_d};
+   int down[] = {(tick / 240) % 2 == 0, (tick / 240) % 2 == 1, (tick / 600) % 4 == 3, tick % 90 < 30};
+   for (int k = 0; k < 4; k++) {
+      SDL_Event e = {};
+      e.type = down[k]?SDL_KEYDOWN:SDL_KEYUP;
+      e.key.keysym.sym = keys[k];
+      fireControlEvent(&e);
+   }
+}
 
-      screens_w = atoi(fileblock + fp);
-      while(!isspace(fileblock[fp])) {
-         fp++;
+// runs the tick loop as fast as it goes with nothing to draw or play,
+// for soak testing levels on machines without a display
+int runHeadless(world *wd, const char *level, int ticks)
+{
+   setupControls(1);
+   loadLevel(wd, level, 0);
+   if (!spawnAtConnection(wd)) {
+      printf("%s: no player spawn and no connections to start at\n", level);
+      return 1;
+   }
+   if (stream_rooms) {
+      stream = createStream(wd);
+   }
+   double freq = SDL_GetPerformanceFrequency();
+   Uint64 worst = 0;
+   Uint64 start = SDL_GetPerformanceCounter();
+   for (int t = 0; t < ticks && running; t++) {
+      Uint64 tick_start = SDL_GetPerformanceCounter();
+      startControlFrame();
+      if (phys_backend == pb_crosscheck) {
+         walkCrosscheckPlayer(t);
       }
-      while(isspace(fileblock[fp])) {
-         fp++;
+      if (stream) {
+         wd = simulateStream(stream);
+      } else {
+         simulate(wd);
       }
+      worst = max(worst, SDL_GetPerformanceCounter() - tick_start);
+   }
+   Uint64 end = SDL_GetPerformanceCounter();
+   double secs = (end - start) / freq;
+   printf("%d ticks in %.3f s, %.0f ticks/s, worst tick %.1f us\n", wd->frame, secs, wd->frame / secs, worst * 1e6 / freq);
+   printf("player at %.1f, %.1f with %d hp, %d enemies, %d effects\n", wd->p1.position.x, wd->p1.position.y, wd->p1.hitpoints,
+         wd->boulders.count + wd->dozers.count + wd->bullets.count + wd->saucers.count + wd->spiders.count + (wd->mirv.active?1:0), wd->effects.count);
+   if (task_times && wd->pipeline) {
+      printTaskTimes(wd->pipeline);
+   }
+   printRoomStats(wd);
+   if (phys_backend == pb_crosscheck) {
+      printf("%d physics mismatches\n", wd->phys_mismatches);
+   }
+   if (stream) {
+      destroyStream(stream);
+      stream = 0;
+   }
+   return 0;
+}
 
-      screens_h = atoi(fileblock + fp);
-      while(!isspace(fileblock[fp])) {
-         fp++;
-      }
-      while(isspace(fileblock[fp])) {
-         fp++;
-      }
+struct batchjob {
+   world **worlds;
+   int ticks;
+};
 
-      resetConnections();
-      while(fileblock[fp] == '+' && room.connection_count < ROOM_CONNECTION_MAX) {
-         char *fstart = fileblock + fp + 1;
-         int fcount = 0;
-         while(!isspace(fileblock[fp])) {
-            fp++;
-            fcount++;
-         }
-         strncpy(room.filenames[room.connection_count], fstart, fcount);
-         room.filenames[room.connection_count][fcount-1] = 0;
-         room.connection_count++;
-         if (connection) {
-            if (strcmp(room.filenames[room.connection_count-1], room.roomname) == 0) {
-               connection = room.connection_count;
-            }
-         }
-         while(isspace(fileblock[fp])) {
-            fp++;
-         }
-      }
-      setRoomName(fname);
-      while(fileblock[fp] == '+') {
-         while(!isspace(fileblock[fp])) {
-            fp++;
-         }
-         while(isspace(fileblock[fp])) {
-            fp++;
+void stepBatchWorld(void *data, int i)
+{
+   batchjob *job = (batchjob*)data;
+   for (int t = 0; t < job->ticks; t++) {
+      simulate(job->worlds[i]);
+   }
+}
+
+// steps a batch of independent worlds, all starting in the same level
+// with their own seeds, and reports how they came out
+int runBatch(const char *level, int count, int ticks, int threads)
+{
+   setupControls(1);
+   startControlFrame();
+   batchjob job;
+   job.worlds = (world**)calloc(count, sizeof(world*));
+   job.ticks = ticks;
+   for (int i = 0; i < count; i++) {
+      job.worlds[i] = createWorld(i + 1);
+      loadLevel(job.worlds[i], level, 0);
+      if (!spawnAtConnection(job.worlds[i])) {
+         printf("%s: no player spawn and no connections to start at\n", level);
+         for (int j = 0; j <= i; j++) {
+            destroyWorld(job.worlds[j]);
          }
+         free(job.worlds);
+         return 1;
       }
+   }
+   threadpool *tp = createThreadPool(threads);
+   double freq = SDL_GetPerformanceFrequency();
+   Uint64 start = SDL_GetPerformanceCounter();
+   parallelFor(tp, count, stepBatchWorld, &job);
+   Uint64 end = SDL_GetPerformanceCounter();
+   destroyThreadPool(tp);
+   double secs = (end - start) / freq;
+   int alive = 0;
+   int hp = 0;
+   for (int i = 0; i < count; i++) {
+      alive += job.worlds[i]->p1.alive?1:0;
+      hp += job.worlds[i]->p1.hitpoints;
+      destroyWorld(job.worlds[i]);
+   }
+   free(job.worlds);
+   printf("%d worlds x %d ticks on %d threads in %.3f s, %.0f ticks/s\n", count, ticks, max(threads, 1), secs, (double)count * ticks / secs);
+   printf("%d players alive, %.1f hp on average\n", alive, count?(double)hp / count:0.0);
+   return 0;
+}
 
-      initTilemap(screens_w, screens_h, tex.wall);
+// paces the main loop to absolute deadlines a frame apart, so a late frame
+// doesn't push every frame after it back. it sleeps most of the wait and
+// only spins the last PACER_SPIN_US, where the sleep can't be trusted
+#define PACER_SPIN_US 300
 
-      camera.bounds.x = 0;
-      camera.bounds.y = 0;
-      camera.bounds.w = (screens_w - 1) * field_w;
-      camera.bounds.h = (screens_h - 1) * field_h;
+struct pacer {
+   Uint64 period;
+   Uint64 deadline;
+   // how late each wakeup was, in performance counter ticks
+   int frames;
+   int missed;
+   double late_sum;
+   double late_sq;
+   Uint64 late_worst;
+};
 
-      room.bounds.x = 0;
-      room.bounds.y = 0;
-      room.bounds.w = (screens_w) * field_w;
-      room.bounds.h = (screens_h) * field_h;
+void startPacer(pacer *pc, Uint64 period)
+{
+   memset(pc, 0, sizeof(pacer));
+   pc->period = period;
+   pc->deadline = SDL_GetPerformanceCounter();
+}
 
-      int tile_xc = field_w_tiles / tiles_w;
-      int tile_yc = field_h_tiles / tiles_h;
-      int rtw = tile_xc * tile_size;
-      int rth = tile_yc * tile_size;
-      int pitch = tiles_w * screens_w;
-      int maxh = tiles_h * screens_h;
-      int tilecount = pitch * maxh;
-      int i = 0;
-      char *block = (char*)malloc(tilecount);
-      while (fp < size) {
-         char c = fileblock[fp];
-         if (!isspace(c)) {
-            block[i++] = c;
-         }
-         fp++;
+void sleepUntil(Uint64 deadline)
+{
+   Uint64 now = SDL_GetPerformanceCounter();
+   Uint64 freq = SDL_GetPerformanceFrequency();
+   Uint64 spin = freq * PACER_SPIN_US / 1000000;
+   if (deadline > now + spin) {
+      Uint64 ns = (deadline - spin - now) * 1000000000 / freq;
+#ifdef __linux__
+      // the performance counter's clock isn't promised to be this one, so
+      // the wake time is worked out from how far away the deadline is
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      ts.tv_sec += ns / 1000000000;
+      ts.tv_nsec += ns % 1000000000;
+      if (ts.tv_nsec >= 1000000000) {
+         ts.tv_sec++;
+         ts.tv_nsec -= 1000000000;
       }
-      free(fileblock);
-      i = 0;
-      int reverse = 0;
-      while (i < tilecount) {
-         switch(block[i]) {
-            case '@':
-               {
-                  if (!connection) {
-                     int x = (i % pitch) * rtw + (0.5*rtw -7);
-                     int y = (i / pitch) * rth + (0.5*rth -7);
-                     p1 = createPlayer(x, y);
-                  }
-               } break;
-            case 's':
-               {
-                  int x = (i % pitch) * tile_xc;
-                  int y = (i / pitch) * tile_yc;
-                  createSaucerMob((x + 1) * tile_size, (y + 1) * tile_size);
-               }break;
-            case 'I':
-            case 'i':
-               {
-                  int x = (i % pitch) * tile_xc;
-                  int y = (i / pitch) * tile_yc;
-                  createItem((x + 1) * tile_size, (y + 1) * tile_size, block[i] == 'I', 1);
-               }break;
-            case 'B':
-            case 'b':
-               {
-                  int x = (i % pitch) * tile_xc;
-                  int y = (i / pitch) * tile_yc;
-                  createBulletMob((x + 1) * tile_size, (y + 1) * tile_size, block[i] == 'b');
-               }break;
-            case 'D':
-            case 'd':
-               {
-                  int x = (i % pitch) * tile_xc;
-                  int y = (i / pitch) * tile_yc;
-                  createDozer((x + 1) * tile_size, (y + 1) * tile_size, block[i] == 'd');
-               }break;
-            case 'P':
-            case 'p':
-               {
-                  int x = (i % pitch) * tile_xc;
-                  int y = (i / pitch) * tile_yc;
-                  createSpiderMob((x + 1) * tile_size, (y + 1) * tile_size, block[i] == 'p');
-               }break;
-            case 'M':
-               {
-                  int x = (i % pitch) * tile_xc;
-                  int y = (i / pitch) * tile_yc;
-                  startMirv((x) * tile_size, (y) * tile_size);
-               }break;
-            case 'O':
-               {
-                  int x = (i % pitch) * tile_xc;
-                  int y = (i / pitch) * tile_yc;
-                  createBoulder((x) * tile_size, (y) * tile_size);
-               }break;
-            case 'l':
-               {
-                  int x = i % pitch;
-                  int y = i / pitch;
-                  int h = 1;
-                  while (y + h < maxh) {
-                     char ex = block[x + (y+h)*pitch];
-                     if (ex == 'l') {
-                        block[x + (y+h)*pitch] = '-';
-                     } else if (ex == 'L') {
-                        block[x + (y+h)*pitch] = '#';
-                     } else {
-                        break;
-                     }
-                     h++;
-                  }
-                  createTileAlignedLadder(x * tile_xc, y * tile_yc, tile_xc, h * tile_yc);
-               } break;
-            case 'L':
-               reverse = 1;
-            case '#':
-               {
-                  int rx = i % pitch;
-                  int ry = i / pitch;
-                  int rw = 1;
-                  int rh = 1;
-                  while (rx + rw < pitch) {
-                     char ex = block[rx + rw + ry * pitch];
-                     if (ex == '#' || ex == 'L') {
-                        rw += 1;
-                     } else {
-                        break;
-                     }
-                  }
-                  while (ry + rh < maxh) {
-                     int expand = 1;
-                     for (int x = rx; x < rx + rw; x++) {
-                        char ex = block[x + (ry + rh)*pitch];
-                        if (ex != '#' && ex != 'L') {
-                           expand = 0;
-                           break;
-                        }
-                     }
-                     if (expand) {
-                        rh += 1;
-                     } else {
-                        break;
-                     }
-                  }
-                  for (int y = ry; y < ry + rh; y++) {
-                     for (int x = rx; x < rx + rw; x++) {
-                        if (block[x + y*pitch] == '#') {
-                           block[x + y*pitch] = ' ';
-                        } else {
-                           block[x + y*pitch] = 'l';
-                        }
-                     }
-                  }
-                  createTileAlignedWall(rx * tile_xc, ry * tile_yc, rw * tile_xc, rh * tile_yc);
-                  setRandomRectangle(rx * tile_xc, ry * tile_yc, rw * tile_xc, rh * tile_yc);
-                  if (reverse) {
-                     reverse = 0;
-                     i--;
-                  }
-               } break;
-            default:
-               if (isdigit(block[i]) && block[i] != '0') {
-                  char n = block[i];
-                  block[i] = ' ';
-                  int v = (n - '0') - 1;
-                  int x = i % pitch;
-                  int y = i / pitch;
-                  if (x == 0) {
-                     int h = 1;
-                     int expand = 1;
-                     while (expand && y + h < maxh) {
-                        char c = block[(y+h)*pitch];
-                        if (c == n) {
-                           block[(y+h)*pitch] = ' ';
-                           h += 1;
-                        } else {
-                           expand = 0;
-                        }
-                     }
-                     rect res = makeTileAlignedRect(-1, y * tile_yc, 2, h * tile_yc);
-                     room.connections[v] = res;
-                     if (v + 1 == connection) {
-                        p1.position.x = res.x + room.transition_offset.x;
-                        p1.position.y = res.y + room.transition_offset.y;
-                     }
-                  } else if (y == 0) {
-                     int w = 1;
-                     int expand = 1;
-                     while (expand && x + w < pitch) {
-                        int offset = x + w + (y)*pitch;
-                        char c = block[offset];
-                        //printf("%c\n", c);
-                        if (c == n) {
-                           block[offset] = ' ';
-                           w += 1;
-                        } else {
-                           expand = 0;
-                        }
-                     }
-                     rect res = makeTileAlignedRect(x * tile_xc, -1, w * tile_xc, 2);
-                     room.connections[v] = res;
-                     if (v + 1 == connection) {
-                        p1.position.x = res.x + room.transition_offset.x;
-                        p1.position.y = res.y + room.transition_offset.y;
-                     }
-                  } else if (x == pitch-1) {
-                     int h = 1;
-                     int expand = 1;
-                     while (expand && y + h < maxh) {
-                        char c = block[pitch - 1 + (y+h)*pitch];
-                        if (c == n) {
-                           block[pitch - 1 + (y+h)*pitch] = ' ';
-                           h += 1;
-                        } else {
-                           expand = 0;
-                        }
-                     }
-                     rect res = makeTileAlignedRect((pitch-1) * tile_xc + 1, y * tile_yc, 2, h * tile_yc);
-                     room.connections[v] = res;
-                     if (v + 1 == connection) {
-                        p1.position.x = res.x + room.transition_offset.x;
-                        p1.position.y = res.y + room.transition_offset.y;
-                     }
-                  } else if (y == maxh-1) {
-                     int w = 1;
-                     int expand = 1;
-                     while (expand && x + w < pitch) {
-                        int offset = x + w + (y)*pitch;
-                        char c = block[offset];
-                        //printf("%c\n", c);
-                        if (c == n) {
-                           block[offset] = ' ';
-                           w += 1;
-                        } else {
-                           expand = 0;
-                        }
-                     }
-                     rect res = makeTileAlignedRect(x * tile_xc, (maxh - 1) * tile_yc + 1, w * tile_xc, 2);
-                     room.connections[v] = res;
-                     if (v + 1 == connection) {
-                        p1.position.x = res.x + room.transition_offset.x;
-                        p1.position.y = res.y + room.transition_offset.y;
-                     }
-                  }
-               }
-               break;
-         }
-         i++;
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR) {
+      }
+#else
+      // SDL_Delay() can run over by a millisecond
+      if (ns > 1000000) {
+         SDL_Delay(ns / 1000000 - 1);
       }
-      srand(time(0));
-      free(block);
+#endif
+   }
+   while (SDL_GetPerformanceCounter() < deadline) {
    }
 }
 
-void reproject_screen(int w, int h)
-{
-   float scale = fmin((float)w / field_w, (float)h / field_h);
-   projection.w = field_w * scale;
-   projection.h = field_h * scale;
-   projection.x = (w - projection.w)/2;
-   projection.y = (h - projection.h)/2;
-}
-
-void setupControls(int forcekeys)
+void waitFrame(pacer *pc)
 {
-   if (!joy) {
-      joy = SDL_JoystickOpen(0);
+   pc->deadline += pc->period;
+   Uint64 now = SDL_GetPerformanceCounter();
+   if (now >= pc->deadline) {
+      // the frame took too long. skip the deadlines already gone by, but
+      // stay on the same beat
+      pc->missed++;
+      pc->deadline += (now - pc->deadline) / pc->period * pc->period;
+      return;
    }
-   clearBindings();
-   if (joy && !forcekeys) {
-      con.left = bindAxis(0, -1);
-      con.right = bindAxis(0, 1);
-      con.up = bindAxis(1, -1);
-      con.down = bindAxis(1, 1);
-      // NOTE(afox): xbox controller buttons are different on windows for some reason?
-#ifdef _WIN32
-      con.jump = bindButton(10);
-      con.fire = bindButton(12);
-      con.reset = bindButton(5);
-#else
-      con.jump = bindButton(0);
-      con.fire = bindButton(2);
-      con.reset = bindButton(8);
-#endif
-   } else {
-      con.left = bindKey(SDLK_LEFT);
-      con.right = bindKey(SDLK_RIGHT);
-      con.up = bindKey(SDLK_UP);
-      con.down = bindKey(SDLK_DOWN);
-      con.jump = bindKey(SDLK_d);
-      con.fire = bindKey(SDLK_f);
-      con.reset = bindKey(SDLK_BACKSPACE);
+   sleepUntil(pc->deadline);
+   Uint64 late = SDL_GetPerformanceCounter() - pc->deadline;
+   pc->frames++;
+   pc->late_sum += late;
+   pc->late_sq += (double)late * late;
+   if (late > pc->late_worst) {
+      pc->late_worst = late;
    }
+}
 
+void printPacerStats(pacer *pc)
+{
+   double us = 1e6 / SDL_GetPerformanceFrequency();
+   double mean = pc->frames?pc->late_sum / pc->frames:0;
+   double var = pc->frames?pc->late_sq / pc->frames - mean * mean:0;
+   printf("%d frames paced at %.2f ms, %d missed\n", pc->frames + pc->missed, pc->period * us / 1000, pc->missed);
+   printf("wakeup late by %.1f us on average, %.1f us deviation, %.1f us worst\n", mean * us, sqrt(fmax(var, 0)) * us, pc->late_worst * us);
 }
 
+// the most steps one frame will run to catch up, past that the game slows
+// down rather than spending longer and longer catching up
+#define MAX_SIM_STEPS 5
+
 int main(int argc, char ** argv)
 {
-   Uint64 step_size = secondsToPCF(0.01);
-   Uint64 next_step = SDL_GetPerformanceCounter() + step_size;
+   int selftest = 0;
+   const char *headless_level = "startroom.txt";
+   int headless_ticks = 100000;
+   int batch = 0;
+   int threads = SDL_GetCPUCount();
+   float sim_rate = 100;
+   // frames a second to draw, -1 for the display's refresh rate
+   float render_rate = -1;
+   const char *profile_csv = 0;
+   int compile_rooms = 0;
+   int pack_assets = 0;
+   const char *profile_trace = 0;
+   // --soft-bands can change it
+   soft.bands = 1;
+   atexit(releaseWallQuery);
+   for (int i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "--tile-physics") == 0) {
+         phys_backend = pb_tiles;
+      } else if (strcmp(argv[i], "--physics-crosscheck") == 0) {
+         phys_backend = pb_crosscheck;
+      } else if (strcmp(argv[i], "--no-simd") == 0) {
+         wall_simd = 0;
+      } else if (strcmp(argv[i], "--physics-selftest") == 0) {
+         selftest = 1;
+      } else if (strcmp(argv[i], "--physics-bench") == 0) {
+         selftest = 2;
+      } else if (strcmp(argv[i], "--pool-bench") == 0) {
+         selftest = 3;
+      } else if (strcmp(argv[i], "--mob-bench") == 0) {
+         selftest = 4;
+      } else if (strcmp(argv[i], "--enemy-bench") == 0) {
+         selftest = 5;
+      } else if (strcmp(argv[i], "--render-bench") == 0) {
+         selftest = 6;
+      } else if (strcmp(argv[i], "--room-bench") == 0) {
+         selftest = 7;
+      } else if (strcmp(argv[i], "--stream") == 0) {
+         stream_rooms = 1;
+      } else if (strcmp(argv[i], "--no-prefetch") == 0) {
+         room_prefetch = 0;
+      } else if (strcmp(argv[i], "--room-cache") == 0 && i + 1 < argc) {
+         room_cache_budget = max(atoi(argv[++i]), 0) * 1024;
+      } else if (strcmp(argv[i], "--soft-render") == 0) {
+         soft.on = 1;
+      } else if (strcmp(argv[i], "--soft-bands") == 0 && i + 1 < argc) {
+         soft.bands = max(atoi(argv[++i]), 1);
+      } else if (strcmp(argv[i], "--max-shots") == 0 && i + 1 < argc) {
+         max_shots = max(atoi(argv[++i]), 1);
+      } else if (strcmp(argv[i], "--headless") == 0) {
+         headless = 1;
+      } else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+         headless_ticks = atoi(argv[++i]);
+      } else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+         headless_level = argv[++i];
+      } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+         batch = atoi(argv[++i]);
+      } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+         threads = max(atoi(argv[++i]), 1);
+      } else if (strcmp(argv[i], "--task-times") == 0) {
+         task_times = 1;
+      } else if (strcmp(argv[i], "--pacer-stats") == 0) {
+         pacer_stats = 1;
+      } else if (strcmp(argv[i], "--compile-rooms") == 0) {
+         compile_rooms = 1;
+      } else if (strcmp(argv[i], "--pack-assets") == 0) {
+         pack_assets = 1;
+      } else if (strcmp(argv[i], "--no-pack") == 0) {
+         pak.on = 0;
+      } else if (strcmp(argv[i], "--profile") == 0) {
+         prof.overlay = 1;
+      } else if (strcmp(argv[i], "--profile-csv") == 0 && i + 1 < argc) {
+         profile_csv = argv[++i];
+      } else if (strcmp(argv[i], "--profile-trace") == 0 && i + 1 < argc) {
+         profile_trace = argv[++i];
+      } else if (strcmp(argv[i], "--sim-rate") == 0 && i + 1 < argc) {
+         sim_rate = fmax(atof(argv[++i]), 1);
+      } else if (strcmp(argv[i], "--render-rate") == 0 && i + 1 < argc) {
+         render_rate = fmax(atof(argv[++i]), 0);
+      } else if (strcmp(argv[i], "--tile-chunks") == 0 && i + 1 < argc) {
+         tilechunk_budget = max(atoi(argv[++i]), 4);
+      }
+   }
+   if (compile_rooms) {
+      SDL_Init(0);
+      atexit(SDL_Quit);
+      return compileRooms()?1:0;
+   }
+   if (pack_assets) {
+      SDL_Init(0);
+      atexit(SDL_Quit);
+      return packAssets()?1:0;
+   }
+   openPak(PAK_FILE);
+   // the checks and benches need no window or audio. the render bench
+   // makes its own software renderer and draws, so it keeps the tile list
+   if (selftest) {
+      SDL_Init(0);
+      atexit(SDL_Quit);
+      headless = (selftest != 6);
+      if (selftest == 5) {
+         return enemyBench()?1:0;
+      } else if (selftest == 6) {
+         return renderBench()?1:0;
+      } else if (selftest == 7) {
+         return roomBench();
+      }
+      // the rest share a world
+      world *wd = createWorld(time(0));
+      wd->jobs = createThreadPool(threads);
+      int res = 0;
+      if (selftest == 1) {
+         res = physicsSelfTest(wd)?1:0;
+      } else if (selftest == 2) {
+         physicsBench(wd);
+      } else if (selftest == 3) {
+         poolBench(wd);
+      } else {
+         mobBench(wd);
+      }
+      destroyThreadPool(wd->jobs);
+      destroyWorld(wd);
+      return res;
+   }
+   if (headless) {
+      SDL_Init(0);
+      atexit(SDL_Quit);
+      if (batch > 0) {
+         return runBatch(headless_level, batch, headless_ticks, threads);
+      }
+      world *wd = createWorld(time(0));
+      wd->jobs = createThreadPool(threads);
+      if (room_prefetch) {
+         wd->loader = createRoomLoader();
+      }
+      return runHeadless(wd, headless_level, headless_ticks);
+   }
    SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_JOYSTICK);
    atexit(SDL_Quit);
    win = SDL_CreateWindow("Saber vs. Merciless Mirv", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, start_w, start_h, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
    ren = SDL_CreateRenderer(win, -1, SDL_RENDERER_ACCELERATED);
-   pixelbuffer = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, field_w, field_h);
+   if (soft.on) {
+      pixelbuffer = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, field_w, field_h);
+   } else {
+      pixelbuffer = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, field_w, field_h);
+   }
    reproject_screen(start_w, start_h);
 
-   tex.saber = loadTexture("saber.gif");
-   tex.robots = loadTexture("robots.gif");
-   tex.wall = loadTexture("wall.gif");
-   tex.stone = loadTexture("boulder.gif");
-   tex.effect = loadTexture("mirvattack.gif");
-   tex.mirv = loadTexture("mirv.gif");
-   tex.ladder = loadTexture("ladder.gif");
+   loadAtlas();
+
+   world *wd = createWorld(time(0));
+   wd->jobs = createThreadPool(threads);
+   if (room_prefetch) {
+      wd->loader = createRoomLoader();
+   }
 
    Mix_Init(0);
    assert(!Mix_OpenAudio(22050, AUDIO_U16SYS, 1, 256));
    Mix_AllocateChannels(16);
-   sound.hit               = Mix_LoadWAV("sound/hit.wav");
-   sound.mirv_engine       = Mix_LoadWAV("sound/mirv_engine.wav");
-   sound.mirv_hit          = Mix_LoadWAV("sound/mirv_hit.wav");
-   sound.mirv_die          = Mix_LoadWAV("sound/mirv_die.wav");
-   sound.mirv_shotgun      = Mix_LoadWAV("sound/mirv_shotgun.wav");
-   sound.reflect           = Mix_LoadWAV("sound/reflect.wav");
-   sound.rock_break        = Mix_LoadWAV("sound/rock_break.wav");
-   sound.saber_die         = Mix_LoadWAV("sound/saber_die.wav");
-   sound.saber_hit         = Mix_LoadWAV("sound/saber_hit.wav");
-   sound.saber_jump        = Mix_LoadWAV("sound/saber_jump.wav");
-   sound.saber_shoot       = Mix_LoadWAV("sound/saber_shoot.wav");
-   sound.saber_heal        = Mix_LoadWAV("sound/saber_heal.wav");
-   sound.spider_hit        = Mix_LoadWAV("sound/spider_hit.wav");
-   sound.spider_shoot      = Mix_LoadWAV("sound/spider_shoot.wav");
-   music.mirv_theme        = Mix_LoadMUS("sound/mirv_theme_scott.wav");
-   music.level_theme       = Mix_LoadMUS("sound/saber_level_theme.wav");
+   for (unsigned i = 0; i < sizeof(sound_files) / sizeof(sound_files[0]); i++) {
+      *sound_files[i].chunk = Mix_LoadWAV_RW(openAsset(sound_files[i].file), 1);
+   }
+   for (unsigned i = 0; i < sizeof(music_files) / sizeof(music_files[0]); i++) {
+      *music_files[i].music = Mix_LoadMUS_RW(openAsset(music_files[i].file), 1);
+   }
 
    testsprite st = createTestSprite(10, 10, 255, 255, 0);
 
-   loadLevel("startroom.txt", 0);
+   loadLevel(wd, "startroom.txt", 0);
+   if (stream_rooms) {
+      stream = createStream(wd);
+   }
 
    float t;
    float angle = 0.f;
@@ -2792,13 +7784,22 @@ int main(int argc, char ** argv)
    v2 testvel;
 
    setupControls(0);
+
+   Uint64 step_size = secondsToPCF(1.0 / sim_rate);
+   if (render_rate < 0) {
+      SDL_DisplayMode mode;
+      render_rate = (SDL_GetCurrentDisplayMode(0, &mode) == 0 && mode.refresh_rate > 0)?mode.refresh_rate:60;
+   }
+   pacer frames;
+   startPacer(&frames, render_rate?secondsToPCF(1.0 / render_rate):0);
+   startProfiler(profile_csv, profile_trace);
+   Uint64 last = SDL_GetPerformanceCounter();
+   // start a step in, so there's a step to draw from the first frame
+   Uint64 behind = step_size;
    
    while (running) {
-      if (con.reset->pressed) {
-         loadLevel("startroom.txt", 0);
-      }
-      startControlFrame();
       SDL_Event e;
+      Uint64 polling = prof.on?SDL_GetPerformanceCounter():0;
       while (SDL_PollEvent(&e)) {
          switch (e.type) {
             case SDL_QUIT:
@@ -2809,6 +7810,10 @@ int main(int argc, char ** argv)
                   reproject_screen(e.window.data1, e.window.data2);
                }
                break;
+            case SDL_RENDER_TARGETS_RESET:
+               // render targets lose what was drawn into them
+               invalidateTileChunks();
+               break;
             case SDL_KEYDOWN:
                if (e.key.keysym.sym == SDLK_ESCAPE) {
                   running = false;
@@ -2816,6 +7821,9 @@ int main(int argc, char ** argv)
                   setupControls(1);
                } else if (e.key.keysym.sym == SDLK_F3) {
                   setupControls(0);
+               } else if (e.key.keysym.sym == SDLK_F4) {
+                  prof.overlay = !prof.overlay;
+                  prof.on = prof.overlay || prof.csv || prof.trace;
                }
             case SDL_KEYUP:
             case SDL_JOYAXISMOTION:
@@ -2827,32 +7835,35 @@ int main(int argc, char ** argv)
                break;
          }
       }
-      if (p1.alive) {
+      if (polling) {
+         profRecord(prof_events, polling);
+      }
+      if (wd->p1.alive) {
          switch (songstate) {
             case ss_silent:
-               if (countof(boulder) == 0) {
+               if (wd->boulders.count == 0) {
                   Mix_FadeInMusic(music.level_theme, -1, 1000);
                   songstate = ss_leveltheme;
                }
-               if (mirv.active) {
+               if (wd->mirv.active) {
                   Mix_FadeInMusic(music.mirv_theme, -1, 1000);
                   songstate = ss_bosstheme;
                }
                break;
             case ss_leveltheme:
-               if (countof(boulder) > 0) {
+               if (wd->boulders.count > 0) {
                   Mix_FadeOutMusic(1000);
                }
                if (!Mix_PlayingMusic()) {
                   songstate = ss_silent;
                }
-               if (mirv.active) {
+               if (wd->mirv.active) {
                   Mix_FadeInMusic(music.mirv_theme, -1, 1000);
                   songstate = ss_bosstheme;
                }
                break;
             case ss_bosstheme:
-               if (!mirv.active) {
+               if (!wd->mirv.active) {
                   Mix_HaltMusic();
                   songstate = ss_silent;
                }
@@ -2862,60 +7873,48 @@ int main(int argc, char ** argv)
          songstate = ss_silent;
          Mix_HaltMusic();
       }
-      SDL_SetRenderTarget(ren, pixelbuffer);
-      SDL_SetRenderDrawColor(ren, 25, 25, 25, 255);
-      SDL_RenderClear(ren);
 
-
-      tickPlayer(&p1);
-      stepPshots();
-      tickEnemies();
-
-
-      SDL_SetRenderDrawColor(ren, 0, 255, 255, 255);
-      //debugDrawWalls(ren);
-      drawTilemap();
-      drawLadders();
-      drawEnemies();
-      doMirv();
-      drawPlayer(&p1);
-      drawPshots();
-      drawEffects();
-      //drawConnections();
-      //drawing goes here
-      SDL_SetRenderTarget(ren, 0);
-      SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
-      SDL_RenderClear(ren);
-      SDL_RenderCopy(ren, pixelbuffer, 0, &projection);
-      SDL_RenderPresent(ren);
-
-      int lload = 0;
-      if (!pointInRect(&room.bounds, &p1.position)) {
-         for (int i = 0; i < ROOM_CONNECTION_MAX; i++) {
-            if (pointInRect(&room.connections[i], &p1.position)) {
-               lload = i + 1;
-               room.transition_offset.x = p1.position.x - room.connections[i].x;
-               room.transition_offset.y = p1.position.y - room.connections[i].y;
-               break;
-            }
+      Uint64 now = SDL_GetPerformanceCounter();
+      behind += now - last;
+      last = now;
+      int steps = 0;
+      while (behind >= step_size && steps < MAX_SIM_STEPS) {
+         if (con.reset->pressed) {
+            loadLevel(wd, "startroom.txt", 0);
          }
+         if (stream) {
+            wd = simulateStream(stream);
+         } else {
+            simulate(wd);
+         }
+         // presses stick around until a step has seen them
+         startControlFrame();
+         behind -= step_size;
+         steps++;
       }
-      if (lload > 0) {
-         char buf[RC_FILE_MAX];
-         strncpy(buf, room.filenames[lload - 1], RC_FILE_MAX);
-         //printf("going to %s\n", buf);
-         loadLevel(buf, 1);
+      // too far behind to catch up, so the game slows down instead
+      behind %= step_size;
+      wd->alpha = (float)behind / step_size;
+      render(wd);
+      if (prof.on) {
+         drainProfiler();
       }
 
-      while (SDL_GetPerformanceCounter() < next_step) {
-#ifdef _WIN32
-         SDL_Delay(0);
-#else
-         SDL_Delay(1);
-#endif
+      if (frames.period) {
+         waitFrame(&frames);
       }
-      next_step = SDL_GetPerformanceCounter() + step_size;
-      frame++;
    }
+   if (task_times && wd->pipeline) {
+      printTaskTimes(wd->pipeline);
+      printRoomStats(wd);
+   }
+   if (pacer_stats) {
+      printPacerStats(&frames);
+   }
+   if (stream) {
+      destroyStream(stream);
+      stream = 0;
+   }
+   stopProfiler();
 }
 
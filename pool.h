@@ -0,0 +1,321 @@
+#ifndef POOL_H
+#define POOL_H
+
+// typed entity pool, replaces the old tc_create/tc_new/tc_erase macros.
+//
+// live items are kept densely packed in index order so tick loops stay
+// plain for loops. erase() swaps the last item into the hole, so a loop
+// that erases at i just looks at i again:
+//
+//    for (int i = 0; i < dozers.count;) {
+//       if (dead) { dozers.erase(i); continue; }
+//       i++;
+//    }
+//
+// items sit in one array, so at() is a plain index. a pool with a limit
+// gets room for all of them the first time something is added and never
+// moves after that. a pool with no limit grows CHUNK items at a time, and
+// an add() that grows it can move everything, so pointers from add()/at()
+// only stay put until the next add() there. anything kept across ticks
+// should hold a handle instead: get() returns 0 once the item it named is
+// gone, even if the slot has been reused since.
+
+#include <stdlib.h>
+#include <string.h>
+
+struct handle {
+   int slot;
+   int generation;
+};
+
+const handle handle_null = {-1, 0};
+
+template <typename T, int CHUNK>
+struct pool {
+   T *items;
+   int cap;
+   int count;
+   // 0 means no limit
+   int limit;
+
+   // slot_dense[slot] is the dense index of the item a slot names,
+   // dense_slot[index] goes the other way
+   int *slot_dense;
+   int *slot_generation;
+   int *dense_slot;
+   int *free_slots;
+   int free_count;
+   // generation new slots start at. release() moves it past every one
+   // handed out, so a handle from before can't name an item added after
+   int first_generation;
+
+   // occupancy stats
+   int high_water;
+   int adds;
+   int erases;
+   int rejected;
+
+   pool(int lim = 0) : items(0), cap(0), count(0), limit(lim),
+      slot_dense(0), slot_generation(0), dense_slot(0), free_slots(0), free_count(0),
+      first_generation(1), high_water(0), adds(0), erases(0), rejected(0)
+   {
+   }
+
+   int capacity() const
+   {
+      return cap;
+   }
+
+   int full() const
+   {
+      return limit > 0 && count >= limit;
+   }
+
+   int empty() const
+   {
+      return count == 0;
+   }
+
+   T* at(int i)
+   {
+      return items + i;
+   }
+
+   T* atSafe(int i)
+   {
+      return (i >= 0 && i < count)?at(i):0;
+   }
+
+   T* back()
+   {
+      return count?at(count - 1):0;
+   }
+
+   void grow()
+   {
+      int old = cap;
+      cap = (limit > 0)?limit:cap + CHUNK;
+      items = (T*)realloc(items, cap * sizeof(T));
+      slot_dense = (int*)realloc(slot_dense, cap * sizeof(int));
+      slot_generation = (int*)realloc(slot_generation, cap * sizeof(int));
+      dense_slot = (int*)realloc(dense_slot, cap * sizeof(int));
+      free_slots = (int*)realloc(free_slots, cap * sizeof(int));
+      // hand out low slots first
+      for (int s = cap - 1; s >= old; s--) {
+         slot_dense[s] = -1;
+         slot_generation[s] = first_generation;
+         free_slots[free_count++] = s;
+      }
+   }
+
+   // the new item is zeroed, returns 0 when the pool is at its limit
+   T* add()
+   {
+      if (full()) {
+         rejected++;
+         return 0;
+      }
+      if (count == capacity()) {
+         grow();
+      }
+      int slot = free_slots[--free_count];
+      slot_dense[slot] = count;
+      dense_slot[count] = slot;
+      T *res = at(count++);
+      memset(res, 0, sizeof(T));
+      adds++;
+      if (count > high_water) {
+         high_water = count;
+      }
+      return res;
+   }
+
+   void erase(int i)
+   {
+      if (i < 0 || i >= count) {
+         return;
+      }
+      int slot = dense_slot[i];
+      int last = count - 1;
+      if (i != last) {
+         *at(i) = *at(last);
+         dense_slot[i] = dense_slot[last];
+         slot_dense[dense_slot[i]] = i;
+      }
+      slot_dense[slot] = -1;
+      slot_generation[slot]++;
+      free_slots[free_count++] = slot;
+      count--;
+      erases++;
+   }
+
+   void clear()
+   {
+      while (count) {
+         erase(count - 1);
+      }
+   }
+
+   // frees all storage, the pool is empty and usable again afterwards
+   void release()
+   {
+      for (int s = 0; s < cap; s++) {
+         if (slot_generation[s] >= first_generation) {
+            first_generation = slot_generation[s] + 1;
+         }
+      }
+      free(items);
+      free(slot_dense);
+      free(slot_generation);
+      free(dense_slot);
+      free(free_slots);
+      items = 0;
+      slot_dense = slot_generation = dense_slot = free_slots = 0;
+      cap = count = free_count = 0;
+   }
+
+   handle handleAt(int i)
+   {
+      if (i < 0 || i >= count) {
+         return handle_null;
+      }
+      handle res = {dense_slot[i], slot_generation[dense_slot[i]]};
+      return res;
+   }
+
+   int indexOf(handle h)
+   {
+      if (h.slot < 0 || h.slot >= capacity() || slot_generation[h.slot] != h.generation) {
+         return -1;
+      }
+      return slot_dense[h.slot];
+   }
+
+   // dense index of an item pointer from at(), -1 if it isn't in this pool
+   int indexOf(T *p)
+   {
+      return (p >= items && p < items + count)?(int)(p - items):-1;
+   }
+
+   T* get(handle h)
+   {
+      int i = indexOf(h);
+      return (i >= 0)?at(i):0;
+   }
+};
+
+// structure-of-arrays set, for mobs whose tick loops only touch a few
+// fields. each field is its own array, so a loop over positions doesn't
+// drag sprites through the cache. same dense, swap-erase layout as pool<>
+// but without handles: nothing holds on to a mob across ticks.
+//
+// declare the columns with an x-macro and let soa_create write the rest:
+//
+//    #define dozer_columns(X) X(v2, position) X(int, hitpoints)
+//    soa_create(dozerset, dozer_columns)
+//    dozerset dozers(16);
+//
+//    int i = dozers.add();
+//    if (i >= 0) dozers.position[i] = ...
+template <typename S>
+struct soa {
+   int count;
+   int cap;
+   // 0 means no limit
+   int limit;
+
+   // occupancy stats
+   int high_water;
+   int adds;
+   int erases;
+   int rejected;
+
+   soa(int lim) : count(0), cap(0), limit(lim), high_water(0), adds(0), erases(0), rejected(0)
+   {
+   }
+
+   int capacity() const
+   {
+      return cap;
+   }
+
+   int full() const
+   {
+      return limit > 0 && count >= limit;
+   }
+
+   int empty() const
+   {
+      return count == 0;
+   }
+
+   void reserve(int n)
+   {
+      if (n > cap) {
+         ((S*)this)->growColumns(n);
+         cap = n;
+      }
+   }
+
+   // index of the new item with every column zeroed, -1 at the limit
+   int add()
+   {
+      if (full()) {
+         rejected++;
+         return -1;
+      }
+      if (count == cap) {
+         reserve(cap?cap * 2:16);
+      }
+      int i = count++;
+      ((S*)this)->clearItem(i);
+      adds++;
+      if (count > high_water) {
+         high_water = count;
+      }
+      return i;
+   }
+
+   void erase(int i)
+   {
+      if (i < 0 || i >= count) {
+         return;
+      }
+      if (i != count - 1) {
+         ((S*)this)->moveItem(i, count - 1);
+      }
+      count--;
+      erases++;
+   }
+
+   void clear()
+   {
+      erases += count;
+      count = 0;
+   }
+
+   void release()
+   {
+      ((S*)this)->freeColumns();
+      count = cap = 0;
+   }
+};
+
+#define soa_column(type, field) type *field;
+#define soa_null_column(type, field) field = 0;
+#define soa_grow_column(type, field) field = (type*)realloc(field, n * sizeof(type));
+#define soa_move_column(type, field) field[to] = field[from];
+#define soa_clear_column(type, field) memset(field + i, 0, sizeof(type));
+#define soa_free_column(type, field) free(field); field = 0;
+
+#define soa_create(name, columns) \
+   struct name : soa<name> { \
+      columns(soa_column) \
+      name(int lim = 0) : soa<name>(lim) { columns(soa_null_column) } \
+      void growColumns(int n) { columns(soa_grow_column) } \
+      void moveItem(int to, int from) { columns(soa_move_column) } \
+      void clearItem(int i) { columns(soa_clear_column) } \
+      void freeColumns() { columns(soa_free_column) } \
+   };
+
+#endif